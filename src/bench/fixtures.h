@@ -0,0 +1,23 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_BENCH_FIXTURES_H_
+#define SRC_BENCH_FIXTURES_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace flow {
+namespace bench {
+
+// Returns a vector with n integers.
+inline std::vector<int> IntVector(int64_t n) {
+  std::vector<int> vec;
+  vec.reserve(n);
+  for (int64_t i = 0; i < n; ++i) {
+    vec.push_back(static_cast<int>(i * 7919));
+  }
+  return vec;
+}
+
+}  // namespace bench
+}  // namespace flow
+#endif  // SRC_BENCH_FIXTURES_H_
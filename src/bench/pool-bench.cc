@@ -0,0 +1,96 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../concurrency/pool.h"
+#include "../io/parallel.h"
+#include "../time/benchmark.h"
+#include "./fixtures.h"
+
+using std::string;
+using std::stringstream;
+using std::vector;
+using flow::bench::IntVector;
+using flow::concurrency::ParallelFor;
+using flow::concurrency::ParallelReduce;
+using flow::concurrency::ThreadPool;
+using flow::io::ParallelStr;
+using flow::io::ParallelWrite;
+using flow::time::BenchmarkState;
+using flow::time::DoNotOptimize;
+
+namespace {
+
+const int64_t kNumItems = 1 << 20;
+
+}  // namespace
+
+// Scaling of a memory-bound reduction with the number of workers.
+void ReduceSum(BenchmarkState& state) {  // NOLINT
+  ThreadPool pool(state.Arg());
+  const vector<int> vec = IntVector(kNumItems);
+  while (state.KeepRunning()) {
+    const int64_t sum = ParallelReduce(pool, 0, vec.size(), int64_t(0),
+        [&vec](size_t b, size_t e) {
+          int64_t partial = 0;
+          for (size_t i = b; i < e; ++i) {
+            partial += vec[i];
+          }
+          return partial;
+        }, [](int64_t a, int64_t b) { return a + b; });
+    DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.Iterations() * kNumItems * sizeof(int));
+  state.SetItemsProcessed(state.Iterations() * kNumItems);
+}
+FLOW_BENCHMARK(ReduceSum)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Scaling of fine-grained tasks, dominated by scheduling overhead.
+void ForEachTiny(BenchmarkState& state) {  // NOLINT
+  ThreadPool pool(state.Arg());
+  vector<int> vec(kNumItems / 16, 0);
+  while (state.KeepRunning()) {
+    ParallelFor(pool, 0, vec.size(), [&vec](size_t i) { ++vec[i]; }, 64);
+  }
+  DoNotOptimize(vec);
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(ForEachTiny)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Scaling of parallel stringification of a large vector.
+void ParallelStrVector(BenchmarkState& state) {  // NOLINT
+  ThreadPool pool(state.Arg());
+  const vector<int> vec = IntVector(kNumItems / 8);
+  int64_t bytes = 0;
+  while (state.KeepRunning()) {
+    const string str = ParallelStr(vec, pool);
+    bytes += str.size();
+    DoNotOptimize(str);
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(ParallelStrVector)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Scaling of parallel serialization of a large string vector.
+void ParallelWriteStrings(BenchmarkState& state) {  // NOLINT
+  ThreadPool pool(state.Arg());
+  vector<string> vec;
+  for (int64_t i = 0; i < kNumItems / 8; ++i) {
+    stringstream ss;
+    ss << "value-" << i;
+    vec.push_back(ss.str());
+  }
+  int64_t bytes = 0;
+  while (state.KeepRunning()) {
+    stringstream ss;
+    ParallelWrite(vec, ss, pool);
+    bytes += ss.tellp();
+    DoNotOptimize(ss);
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(ParallelWriteStrings)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+FLOW_BENCHMARK_MAIN()
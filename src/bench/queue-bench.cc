@@ -0,0 +1,222 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../concurrency/queue.h"
+#include "../time/benchmark.h"
+
+using std::atomic;
+using std::thread;
+using std::vector;
+using flow::concurrency::BlockingQueue;
+using flow::concurrency::MpmcQueue;
+using flow::concurrency::SpscQueue;
+using flow::time::BenchmarkState;
+using flow::time::DoNotOptimize;
+
+namespace {
+
+const size_t kCapacity = 1024;
+const size_t kBatchSize = 32;
+
+// Bounded queue guarded by a mutex, the baseline for the lock-free queues.
+template<typename T>
+class MutexQueue {
+ public:
+  typedef T ValueType;
+
+  explicit MutexQueue(size_t capacity)
+      : capacity_(capacity) {}
+
+  bool TryPush(const T& item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.size() == capacity_) {
+      return false;
+    }
+    items_.push_back(item);
+    return true;
+  }
+
+  bool TryPop(T* target) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.empty()) {
+      return false;
+    }
+    *target = items_.front();
+    items_.pop_front();
+    return true;
+  }
+
+ private:
+  const size_t capacity_;
+  std::mutex mutex_;
+  std::deque<T> items_;
+};
+
+// Pushes n items in total from the given number of producer threads.
+template<typename Queue>
+vector<thread> StartProducers(Queue* queue, int num_producers, int64_t n) {
+  vector<thread> producers;
+  for (int p = 0; p < num_producers; ++p) {
+    const int64_t count = n / num_producers + (p < n % num_producers);
+    producers.push_back(thread([queue, count]() {
+      for (int64_t i = 0; i < count; ++i) {
+        while (!queue->TryPush(i)) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+  return producers;
+}
+
+// Transfers one item per iteration from the producer threads to the
+// benchmarking thread.
+template<typename Queue>
+void Transfer(BenchmarkState& state, int num_producers) {  // NOLINT
+  Queue queue(kCapacity);
+  vector<thread> producers = StartProducers(&queue, num_producers,
+                                            state.Iterations());
+  int64_t item = 0;
+  while (state.KeepRunning()) {
+    while (!queue.TryPop(&item)) {
+      std::this_thread::yield();
+    }
+  }
+  DoNotOptimize(item);
+  for (auto& producer: producers) {
+    producer.join();
+  }
+  state.SetItemsProcessed(state.Iterations());
+}
+
+// Transfers one item per iteration from the benchmarking thread to the
+// consumer threads.
+template<typename Queue>
+void Distribute(BenchmarkState& state, int num_consumers) {  // NOLINT
+  Queue queue(kCapacity);
+  atomic<bool> done(false);
+  vector<thread> consumers;
+  for (int c = 0; c < num_consumers; ++c) {
+    consumers.push_back(thread([&queue, &done]() {
+      int64_t item = 0;
+      while (true) {
+        const bool last = done.load(std::memory_order_acquire);
+        if (!queue.TryPop(&item)) {
+          if (last) {
+            break;
+          }
+          std::this_thread::yield();
+        }
+      }
+      DoNotOptimize(item);
+    }));
+  }
+  int64_t i = 0;
+  while (state.KeepRunning()) {
+    while (!queue.TryPush(i)) {
+      std::this_thread::yield();
+    }
+    ++i;
+  }
+  done.store(true, std::memory_order_release);
+  for (auto& consumer: consumers) {
+    consumer.join();
+  }
+  state.SetItemsProcessed(state.Iterations());
+}
+
+}  // namespace
+
+// Single producer, single consumer.
+void SpscTransfer(BenchmarkState& state) {  // NOLINT
+  Transfer<SpscQueue<int64_t> >(state, 1);
+}
+FLOW_BENCHMARK(SpscTransfer);
+
+// Batched transfer, publishing kBatchSize items per index update.
+void SpscTransferBatch(BenchmarkState& state) {  // NOLINT
+  SpscQueue<int64_t> queue(kCapacity);
+  const int64_t n = state.Iterations() * kBatchSize;
+  thread producer([&queue, n]() {
+    int64_t items[kBatchSize];
+    for (int64_t i = 0; i < n;) {
+      size_t count = 0;
+      for (; count < kBatchSize && i + int64_t(count) < n; ++count) {
+        items[count] = i + count;
+      }
+      size_t pushed = 0;
+      while (pushed < count) {
+        const size_t k = queue.TryPushBatch(items + pushed, count - pushed);
+        if (k == 0) {
+          std::this_thread::yield();
+        }
+        pushed += k;
+      }
+      i += count;
+    }
+  });
+  int64_t items[kBatchSize];
+  while (state.KeepRunning()) {
+    size_t popped = 0;
+    while (popped < kBatchSize) {
+      const size_t k = queue.TryPopBatch(items, kBatchSize - popped);
+      if (k == 0) {
+        std::this_thread::yield();
+      }
+      popped += k;
+    }
+  }
+  DoNotOptimize(items);
+  producer.join();
+  state.SetItemsProcessed(state.Iterations() * kBatchSize);
+}
+FLOW_BENCHMARK(SpscTransferBatch);
+
+// Multiple producers, single consumer.
+void MpmcTransfer(BenchmarkState& state) {  // NOLINT
+  Transfer<MpmcQueue<int64_t> >(state, state.Arg());
+}
+FLOW_BENCHMARK(MpmcTransfer)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Single producer, multiple consumers.
+void MpmcDistribute(BenchmarkState& state) {  // NOLINT
+  Distribute<MpmcQueue<int64_t> >(state, state.Arg());
+}
+FLOW_BENCHMARK(MpmcDistribute)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Blocking single producer, single consumer.
+void BlockingTransfer(BenchmarkState& state) {  // NOLINT
+  BlockingQueue<SpscQueue<int64_t> > queue(kCapacity);
+  const int64_t n = state.Iterations();
+  thread producer([&queue, n]() {
+    for (int64_t i = 0; i < n; ++i) {
+      queue.Push(i);
+    }
+  });
+  int64_t item = 0;
+  while (state.KeepRunning()) {
+    queue.Pop(&item);
+  }
+  DoNotOptimize(item);
+  producer.join();
+  state.SetItemsProcessed(state.Iterations());
+}
+FLOW_BENCHMARK(BlockingTransfer);
+
+// Baseline: multiple producers, single consumer on a mutex-guarded queue.
+void MutexTransfer(BenchmarkState& state) {  // NOLINT
+  Transfer<MutexQueue<int64_t> >(state, state.Arg());
+}
+FLOW_BENCHMARK(MutexTransfer)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Baseline: single producer, multiple consumers on a mutex-guarded queue.
+void MutexDistribute(BenchmarkState& state) {  // NOLINT
+  Distribute<MutexQueue<int64_t> >(state, state.Arg());
+}
+FLOW_BENCHMARK(MutexDistribute)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+FLOW_BENCHMARK_MAIN()
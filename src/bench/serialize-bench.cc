@@ -0,0 +1,101 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../io/serialize.h"
+#include "../time/benchmark.h"
+#include "./fixtures.h"
+
+using std::map;
+using std::string;
+using std::stringstream;
+using std::unordered_map;
+using std::vector;
+using flow::bench::IntVector;
+using flow::io::Read;
+using flow::io::Write;
+using flow::time::BenchmarkState;
+using flow::time::DoNotOptimize;
+
+namespace {
+
+// Returns a map with n short string keys mapped to small vectors.
+unordered_map<string, vector<int> > StringMap(int64_t n) {
+  unordered_map<string, vector<int> > m;
+  for (int64_t i = 0; i < n; ++i) {
+    stringstream key;
+    key << "key-" << i;
+    m[key.str()] = IntVector(i % 8);
+  }
+  return m;
+}
+
+// Returns the number of bytes of the serialized container.
+template<typename T>
+int64_t SerializedSize(const T& con) {
+  stringstream ss;
+  Write(con, ss);
+  return ss.str().size();
+}
+
+}  // namespace
+
+void WriteVector(BenchmarkState& state) {  // NOLINT
+  const vector<int> vec = IntVector(state.Arg());
+  while (state.KeepRunning()) {
+    stringstream ss;
+    Write(vec, ss);
+    DoNotOptimize(ss);
+  }
+  state.SetBytesProcessed(state.Iterations() * SerializedSize(vec));
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(WriteVector)->Arg(1000)->Arg(100000);
+
+void ReadVector(BenchmarkState& state) {  // NOLINT
+  const vector<int> vec = IntVector(state.Arg());
+  stringstream in;
+  Write(vec, in);
+  const string data = in.str();
+  while (state.KeepRunning()) {
+    stringstream ss(data);
+    vector<int> target;
+    Read(ss, &target);
+    DoNotOptimize(target);
+  }
+  state.SetBytesProcessed(state.Iterations() * data.size());
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(ReadVector)->Arg(1000)->Arg(100000);
+
+void WriteStringMap(BenchmarkState& state) {  // NOLINT
+  const unordered_map<string, vector<int> > m = StringMap(state.Arg());
+  while (state.KeepRunning()) {
+    stringstream ss;
+    Write(m, ss);
+    DoNotOptimize(ss);
+  }
+  state.SetBytesProcessed(state.Iterations() * SerializedSize(m));
+  state.SetItemsProcessed(state.Iterations() * m.size());
+}
+FLOW_BENCHMARK(WriteStringMap)->Arg(1000)->Arg(10000);
+
+void ReadStringMap(BenchmarkState& state) {  // NOLINT
+  const unordered_map<string, vector<int> > m = StringMap(state.Arg());
+  stringstream in;
+  Write(m, in);
+  const string data = in.str();
+  while (state.KeepRunning()) {
+    stringstream ss(data);
+    unordered_map<string, vector<int> > target;
+    Read(ss, &target);
+    DoNotOptimize(target);
+  }
+  state.SetBytesProcessed(state.Iterations() * data.size());
+  state.SetItemsProcessed(state.Iterations() * m.size());
+}
+FLOW_BENCHMARK(ReadStringMap)->Arg(1000)->Arg(10000);
+
+FLOW_BENCHMARK_MAIN()
@@ -0,0 +1,76 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../io/stringify.h"
+#include "../time/benchmark.h"
+#include "../time/clock.h"
+#include "./fixtures.h"
+
+using std::map;
+using std::string;
+using std::stringstream;
+using std::vector;
+using flow::bench::IntVector;
+using flow::io::Str;
+using flow::time::BenchmarkState;
+using flow::time::ClockDiff;
+using flow::time::DoNotOptimize;
+
+void StrVector(BenchmarkState& state) {  // NOLINT
+  const vector<int> vec = IntVector(state.Arg());
+  int64_t bytes = 0;
+  while (state.KeepRunning()) {
+    const string str = Str(vec);
+    bytes += str.size();
+    DoNotOptimize(str);
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(StrVector)->Arg(1000)->Arg(100000);
+
+void StreamVector(BenchmarkState& state) {  // NOLINT
+  const vector<int> vec = IntVector(state.Arg());
+  int64_t bytes = 0;
+  while (state.KeepRunning()) {
+    stringstream ss;
+    ss << vec;
+    bytes += ss.tellp();
+    DoNotOptimize(ss);
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.Iterations() * vec.size());
+}
+FLOW_BENCHMARK(StreamVector)->Arg(1000)->Arg(100000);
+
+void StrNestedMap(BenchmarkState& state) {  // NOLINT
+  map<string, vector<int> > m;
+  for (int64_t i = 0; i < state.Arg(); ++i) {
+    stringstream key;
+    key << "key-" << i;
+    m[key.str()] = IntVector(i % 8);
+  }
+  int64_t bytes = 0;
+  while (state.KeepRunning()) {
+    const string str = Str(m);
+    bytes += str.size();
+    DoNotOptimize(str);
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.Iterations() * m.size());
+}
+FLOW_BENCHMARK(StrNestedMap)->Arg(1000)->Arg(10000);
+
+void StrClockDiff(BenchmarkState& state) {  // NOLINT
+  const ClockDiff diff = ClockDiff::FromNanos(123456789);
+  while (state.KeepRunning()) {
+    const string str = diff.Str();
+    DoNotOptimize(str);
+  }
+  state.SetItemsProcessed(state.Iterations());
+}
+FLOW_BENCHMARK(StrClockDiff);
+
+FLOW_BENCHMARK_MAIN()
@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_BENCHMARK_H_
+#define SRC_BENCHMARK_H_
+
+#include "./time/benchmark.h"
+
+#endif  // SRC_BENCHMARK_H_
@@ -0,0 +1,2 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include "./pool.h"
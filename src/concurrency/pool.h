@@ -0,0 +1,327 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_CONCURRENCY_POOL_H_
+#define SRC_CONCURRENCY_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace flow {
+namespace concurrency {
+
+// Work-stealing thread pool. Each worker owns a task deque: tasks submitted by
+// a worker are pushed to and popped from the back of its own deque, idle
+// workers steal from the front of the other deques. Workers park on a
+// condition variable when no task is left.
+class ThreadPool {
+ public:
+  typedef std::function<void()> Task;
+
+  // Starts the given number of worker threads.
+  explicit ThreadPool(size_t num_threads = DefaultThreads())
+      : pending_(0),
+        next_(0),
+        parked_(0),
+        stop_(false) {
+    num_threads = num_threads > 0 ? num_threads : 1;
+    for (size_t i = 0; i < num_threads; ++i) {
+      workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads_.push_back(std::thread(&ThreadPool::Run, this, i));
+    }
+  }
+
+  // Runs the remaining tasks and joins the worker threads.
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread: threads_) {
+      thread.join();
+    }
+  }
+
+  // Returns the number of hardware threads, at least 1.
+  static size_t DefaultThreads() {
+    const size_t n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+  }
+
+  // Submits the given function call and returns the future for its result.
+  // Exceptions thrown by the function are rethrown by the future.
+  template<typename F, typename... Args>
+  std::future<typename std::result_of<F(Args...)>::type> Submit(
+      F&& f, Args&&... args) {
+    typedef typename std::result_of<F(Args...)>::type R;
+    std::shared_ptr<std::packaged_task<R()> > task(
+        new std::packaged_task<R()>(std::bind(std::forward<F>(f),
+                                              std::forward<Args>(args)...)));
+    std::future<R> future = task->get_future();
+    Post([task]() { (*task)(); });
+    return future;
+  }
+
+  // Submits the given task without result.
+  void Post(Task task) {
+    Local& local = LocalWorker();
+    const size_t index = local.pool == this ? local.index :
+        next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+      Worker& worker = *workers_[index];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.tasks.push_back(std::move(task));
+    }
+    // Sequentially consistent, so that either a parking worker sees the task
+    // or this thread sees the parking worker.
+    pending_.fetch_add(1);
+    if (parked_.load() > 0) {
+      {
+        // Synchronizes with parking workers to avoid lost wake-ups.
+        std::lock_guard<std::mutex> lock(mutex_);
+      }
+      cv_.notify_one();
+    }
+  }
+
+  // Runs a pending task on the calling thread. Returns false if no task was
+  // available. Used to help while waiting for results.
+  bool RunPendingTask() {
+    Local& local = LocalWorker();
+    Task task;
+    if (local.pool == this) {
+      if (!Pop(local.index, &task) && !Steal(local.index, &task)) {
+        return false;
+      }
+    } else if (!Steal(next_.load(std::memory_order_relaxed), &task)) {
+      return false;
+    }
+    task();
+    return true;
+  }
+
+  // Returns the number of worker threads.
+  size_t NumThreads() const {
+    return workers_.size();
+  }
+
+ private:
+  // Task deque of a worker.
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // Identifies the pool and worker index of the calling thread.
+  struct Local {
+    ThreadPool* pool;
+    size_t index;
+  };
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  static Local& LocalWorker() {
+    static thread_local Local local = {nullptr, 0};
+    return local;
+  }
+
+  // Pops the most recently pushed task of the given worker.
+  bool Pop(size_t index, Task* task) {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      return false;
+    }
+    *task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Steals the oldest task of the workers, starting after the given index.
+  bool Steal(size_t index, Task* task) {
+    const size_t n = workers_.size();
+    for (size_t i = 1; i <= n; ++i) {
+      Worker& worker = *workers_[(index + i) % n];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (!worker.tasks.empty()) {
+        *task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Worker thread loop.
+  void Run(size_t index) {
+    Local& local = LocalWorker();
+    local.pool = this;
+    local.index = index;
+    while (true) {
+      Task task;
+      if (Pop(index, &task) || Steal(index, &task)) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      parked_.fetch_add(1);
+      cv_.wait(lock, [this]() {
+        return stop_ || pending_.load() > 0;
+      });
+      parked_.fetch_sub(1, std::memory_order_relaxed);
+      if (stop_ && pending_.load(std::memory_order_acquire) <= 0) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker> > workers_;
+  std::vector<std::thread> threads_;
+  // Number of queued tasks, may be transiently negative.
+  std::atomic<int64_t> pending_;
+  // Round-robin worker index for tasks submitted by external threads.
+  std::atomic<size_t> next_;
+  // Number of parked workers, submitters only notify if there are any.
+  std::atomic<int> parked_;
+  // Parking state, guarded by the mutex.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+};
+
+// Returns the process-wide pool with one worker per hardware thread.
+inline ThreadPool& DefaultPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+// Returns the grain size splitting n items into about four chunks per
+// participating thread (the workers and the calling thread).
+inline size_t GrainSize(size_t n, size_t num_threads) {
+  const size_t num_chunks = 4 * (num_threads + 1);
+  const size_t grain = (n + num_chunks - 1) / num_chunks;
+  return grain > 0 ? grain : 1;
+}
+
+// Calls func(chunk_begin, chunk_end) for consecutive chunks of [begin, end)
+// in parallel and returns when all chunks are done. The calling thread
+// processes chunks too, so that nested calls from within tasks do not
+// deadlock, and parks once no task is left until the last chunk is done. The
+// first exception thrown is rethrown. A grain size of 0 selects the grain size
+// automatically.
+template<typename RangeFunc>
+void ParallelForRange(ThreadPool& pool, size_t begin, size_t end,  // NOLINT
+                      RangeFunc func, size_t grain = 0) {
+  if (begin >= end) {
+    return;
+  }
+  const size_t n = end - begin;
+  grain = grain > 0 ? grain : GrainSize(n, pool.NumThreads());
+  const size_t num_chunks = (n + grain - 1) / grain;
+  if (num_chunks == 1) {
+    func(begin, end);
+    return;
+  }
+  std::atomic<size_t> remaining(num_chunks);
+  // Completion state, guarded by the mutex.
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  std::exception_ptr error;
+  auto run_chunk = [&](size_t chunk) {
+    const size_t chunk_begin = begin + chunk * grain;
+    const size_t chunk_end = chunk_begin + grain < end ?
+        chunk_begin + grain : end;
+    try {
+      func(chunk_begin, chunk_end);
+    } catch(...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      cv.notify_one();
+    }
+  };
+  for (size_t chunk = 1; chunk < num_chunks; ++chunk) {
+    pool.Post([&run_chunk, chunk]() { run_chunk(chunk); });
+  }
+  run_chunk(0);
+  while (remaining.load(std::memory_order_acquire) > 0 &&
+         pool.RunPendingTask()) {}
+  {
+    // Waits for the chunks still run by other threads. Always synchronizes
+    // with the last chunk, which must not touch the completion state after
+    // this call returned.
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&done]() { return done; });
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// Calls func(i) for each index in [begin, end) in parallel.
+template<typename Func>
+void ParallelFor(ThreadPool& pool, size_t begin, size_t end,  // NOLINT
+                 Func func, size_t grain = 0) {
+  ParallelForRange(pool, begin, end, [&func](size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i) {
+      func(i);
+    }
+  }, grain);
+}
+
+// Reduces [begin, end) in parallel: func(chunk_begin, chunk_end) returns the
+// partial result of a chunk, the partial results are combined in index order
+// starting with identity, so that associative combine functions yield
+// deterministic results.
+template<typename T, typename RangeFunc, typename Combine>
+T ParallelReduce(ThreadPool& pool, size_t begin, size_t end,  // NOLINT
+                 const T& identity, RangeFunc func, Combine combine,
+                 size_t grain = 0) {
+  if (begin >= end) {
+    return identity;
+  }
+  const size_t n = end - begin;
+  grain = grain > 0 ? grain : GrainSize(n, pool.NumThreads());
+  const size_t num_chunks = (n + grain - 1) / grain;
+  // Wrapped to avoid packed std::vector<bool> elements.
+  struct Partial {
+    T value;
+  };
+  std::vector<Partial> partials(num_chunks, Partial{identity});
+  ParallelFor(pool, 0, num_chunks, [&](size_t chunk) {
+    const size_t chunk_begin = begin + chunk * grain;
+    const size_t chunk_end = chunk_begin + grain < end ?
+        chunk_begin + grain : end;
+    partials[chunk].value = func(chunk_begin, chunk_end);
+  }, 1);
+  T result = identity;
+  for (const auto& partial: partials) {
+    result = combine(result, partial.value);
+  }
+  return result;
+}
+
+}  // namespace concurrency
+}  // namespace flow
+#endif  // SRC_CONCURRENCY_POOL_H_
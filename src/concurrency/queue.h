@@ -0,0 +1,462 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_CONCURRENCY_QUEUE_H_
+#define SRC_CONCURRENCY_QUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "../time/cache.h"
+
+namespace flow {
+namespace concurrency {
+
+using flow::time::kCacheLineSize;
+
+// Returns the smallest power of 2 not less than the given value and 2.
+inline size_t NextPowerOfTwo(size_t value) {
+  size_t power = 2;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+// Bounded lock-free single-producer single-consumer ring buffer. One thread
+// may push while another thread pops. The producer and consumer indices are
+// kept on separate cache lines, each side caches the other side's index to
+// avoid touching its cache line on every operation. The capacity is rounded
+// up to the next power of 2.
+template<typename T>
+class SpscQueue {
+ public:
+  typedef T ValueType;
+
+  explicit SpscQueue(size_t capacity)
+      : capacity_(NextPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        buffer_(new Storage[capacity_]),
+        head_(0),
+        cached_tail_(0),
+        tail_(0),
+        cached_head_(0) {}
+
+  ~SpscQueue() {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    for (size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i) {
+      Slot(i)->~T();
+    }
+  }
+
+  // Pushes a copy of the given item. Returns false if the queue is full.
+  bool TryPush(const T& item) {
+    return Emplace(item);
+  }
+
+  // Pushes the given item. Returns false if the queue is full.
+  bool TryPush(T&& item) {
+    return Emplace(std::move(item));
+  }
+
+  // Pops the oldest item into the target. Returns false if the queue is empty.
+  bool TryPop(T* target) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    T* item = Slot(head);
+    *target = std::move(*item);
+    item->~T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes up to n items, moving them out of the given array, and publishes
+  // them at once. Returns the number of pushed items.
+  size_t TryPushBatch(T* items, size_t n) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail + n - cached_head_ > capacity_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+    }
+    const size_t free = capacity_ - (tail - cached_head_);
+    n = n < free ? n : free;
+    for (size_t i = 0; i < n; ++i) {
+      new(Slot(tail + i)) T(std::move(items[i]));
+    }
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Pops up to n items into the given array and releases their slots at once.
+  // Returns the number of popped items.
+  size_t TryPopBatch(T* targets, size_t n) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (cached_tail_ - head < n) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+    }
+    const size_t available = cached_tail_ - head;
+    n = n < available ? n : available;
+    for (size_t i = 0; i < n; ++i) {
+      T* item = Slot(head + i);
+      targets[i] = std::move(*item);
+      item->~T();
+    }
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // Returns the number of items, only exact if neither side is active.
+  size_t SizeApprox() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  // Returns the maximum number of items.
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+ private:
+  typedef typename std::aligned_storage<sizeof(T),
+      std::alignment_of<T>::value>::type Storage;
+
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+  template<typename U>
+  bool Emplace(U&& item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == capacity_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == capacity_) {
+        return false;
+      }
+    }
+    new(Slot(tail)) T(std::forward<U>(item));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  T* Slot(size_t index) {
+    return reinterpret_cast<T*>(&buffer_[index & mask_]);
+  }
+
+  char padding0_[kCacheLineSize];
+  const size_t capacity_;
+  const size_t mask_;
+  const std::unique_ptr<Storage[]> buffer_;
+  char padding1_[kCacheLineSize];
+  // Consumer side.
+  std::atomic<size_t> head_;
+  size_t cached_tail_;
+  char padding2_[kCacheLineSize];
+  // Producer side.
+  std::atomic<size_t> tail_;
+  size_t cached_head_;
+  char padding3_[kCacheLineSize];
+};
+
+// Bounded lock-free multi-producer multi-consumer queue based on per-slot
+// sequence numbers (Vyukov). Any number of threads may push and pop
+// concurrently, each operation claims a slot with a single CAS on the
+// producer or consumer index. The capacity is rounded up to the next power
+// of 2.
+template<typename T>
+class MpmcQueue {
+ public:
+  typedef T ValueType;
+
+  explicit MpmcQueue(size_t capacity)
+      : capacity_(NextPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        cells_(new Cell[capacity_]),
+        tail_(0),
+        head_(0) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpmcQueue() {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    for (size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i) {
+      reinterpret_cast<T*>(&cells_[i & mask_].storage)->~T();
+    }
+  }
+
+  // Pushes a copy of the given item. Returns false if the queue is full.
+  bool TryPush(const T& item) {
+    return Emplace(item);
+  }
+
+  // Pushes the given item. Returns false if the queue is full.
+  bool TryPush(T&& item) {
+    return Emplace(std::move(item));
+  }
+
+  // Pops the oldest item into the target. Returns false if the queue is empty.
+  bool TryPop(T* target) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) -
+                            static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    T* item = reinterpret_cast<T*>(&cell->storage);
+    *target = std::move(*item);
+    item->~T();
+    cell->seq.store(pos + capacity_, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes up to n items, moving them out of the given array. Returns the
+  // number of pushed items. The batch is not pushed atomically, items of
+  // concurrent producers may interleave.
+  size_t TryPushBatch(T* items, size_t n) {
+    size_t i = 0;
+    while (i < n && Emplace(std::move(items[i]))) {
+      ++i;
+    }
+    return i;
+  }
+
+  // Pops up to n items into the given array. Returns the number of popped
+  // items.
+  size_t TryPopBatch(T* targets, size_t n) {
+    size_t i = 0;
+    while (i < n && TryPop(&targets[i])) {
+      ++i;
+    }
+    return i;
+  }
+
+  // Returns the number of items, only exact if no thread is active.
+  size_t SizeApprox() const {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    const size_t head = head_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  // Returns the maximum number of items.
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+ private:
+  typedef typename std::aligned_storage<sizeof(T),
+      std::alignment_of<T>::value>::type Storage;
+
+  struct Cell {
+    std::atomic<size_t> seq;
+    Storage storage;
+  };
+
+  MpmcQueue(const MpmcQueue&);
+  MpmcQueue& operator=(const MpmcQueue&);
+
+  template<typename U>
+  bool Emplace(U&& item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) -
+                            static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    new(&cell->storage) T(std::forward<U>(item));
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  char padding0_[kCacheLineSize];
+  const size_t capacity_;
+  const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  char padding1_[kCacheLineSize];
+  std::atomic<size_t> tail_;
+  char padding2_[kCacheLineSize];
+  std::atomic<size_t> head_;
+  char padding3_[kCacheLineSize];
+};
+
+// Blocking wrapper for the lock-free queues. Push and Pop spin briefly and
+// then park on a condition variable until the queue has free slots or items
+// again. The mutex is only touched when a thread is parked, so that the
+// wrapper adds no locking to the fast path. After Close, pushes fail and pops
+// fail once the queue is drained.
+template<typename Queue>
+class BlockingQueue {
+ public:
+  typedef typename Queue::ValueType ValueType;
+
+  explicit BlockingQueue(size_t capacity)
+      : queue_(capacity),
+        closed_(false),
+        waiting_producers_(0),
+        waiting_consumers_(0) {}
+
+  // Pushes the given item, blocks while the queue is full. Returns false if
+  // the queue has been closed.
+  bool Push(ValueType item) {
+    if (!Wait(&waiting_producers_, &not_full_, false, [this, &item]() {
+          return queue_.TryPush(std::move(item));
+        })) {
+      return false;
+    }
+    Notify(&waiting_consumers_, &not_empty_, 1);
+    return true;
+  }
+
+  // Pops the oldest item into the target, blocks while the queue is empty.
+  // Returns false if the queue has been closed and drained.
+  bool Pop(ValueType* target) {
+    if (!Wait(&waiting_consumers_, &not_empty_, true, [this, target]() {
+          return queue_.TryPop(target);
+        })) {
+      return false;
+    }
+    Notify(&waiting_producers_, &not_full_, 1);
+    return true;
+  }
+
+  // Pushes up to n items without blocking. Returns the number of pushed items.
+  size_t TryPushBatch(ValueType* items, size_t n) {
+    if (closed_.load(std::memory_order_acquire)) {
+      return 0;
+    }
+    const size_t pushed = queue_.TryPushBatch(items, n);
+    if (pushed) {
+      Notify(&waiting_consumers_, &not_empty_, pushed);
+    }
+    return pushed;
+  }
+
+  // Pops up to n items, blocks until at least one item is available. Returns
+  // the number of popped items, 0 if the queue has been closed and drained.
+  size_t PopBatch(ValueType* targets, size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    size_t popped = 0;
+    Wait(&waiting_consumers_, &not_empty_, true,
+         [this, targets, n, &popped]() {
+      popped = queue_.TryPopBatch(targets, n);
+      return popped > 0;
+    });
+    if (popped) {
+      Notify(&waiting_producers_, &not_full_, popped);
+    }
+    return popped;
+  }
+
+  // Closes the queue and wakes all waiting threads.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_.store(true, std::memory_order_release);
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  // Returns the wrapped queue for non-blocking access.
+  Queue& Unwrapped() {
+    return queue_;
+  }
+
+ private:
+  static const int kSpins = 64;
+
+  BlockingQueue(const BlockingQueue&);
+  BlockingQueue& operator=(const BlockingQueue&);
+
+  // Runs the given operation until it succeeds or the queue is closed, parks
+  // on the condition variable after spinning. Once closed, the operation is
+  // only retried if drain is set. Returns whether the operation succeeded.
+  template<typename Operation>
+  bool Wait(std::atomic<int>* waiting, std::condition_variable* cv,
+            bool drain, Operation operation) {
+    for (int i = 0; i < kSpins; ++i) {
+      if (closed_.load(std::memory_order_acquire)) {
+        return drain && operation();
+      }
+      if (operation()) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting->fetch_add(1, std::memory_order_seq_cst);
+    // Orders the announcement before the retry, pairs with the fence in
+    // Notify so that either the retry succeeds or the notifier sees us.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool done = false;
+    while (!closed_.load(std::memory_order_acquire) && !(done = operation())) {
+      cv->wait(lock);
+    }
+    waiting->fetch_sub(1, std::memory_order_relaxed);
+    return done || (drain && operation());
+  }
+
+  // Wakes one waiting thread per transferred item, if there are any waiting.
+  void Notify(std::atomic<int>* waiting, std::condition_variable* cv,
+              size_t num_items) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int num_waiting = waiting->load(std::memory_order_relaxed);
+    if (num_waiting > 0) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+      }
+      if (num_items >= static_cast<size_t>(num_waiting)) {
+        cv->notify_all();
+      } else {
+        for (size_t i = 0; i < num_items; ++i) {
+          cv->notify_one();
+        }
+      }
+    }
+  }
+
+  Queue queue_;
+  std::atomic<bool> closed_;
+  std::atomic<int> waiting_producers_;
+  std::atomic<int> waiting_consumers_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+}  // namespace concurrency
+}  // namespace flow
+#endif  // SRC_CONCURRENCY_QUEUE_H_
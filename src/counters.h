@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_COUNTERS_H_
+#define SRC_COUNTERS_H_
+
+#include "./time/counters.h"
+
+#endif  // SRC_COUNTERS_H_
@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_HISTOGRAM_H_
+#define SRC_HISTOGRAM_H_
+
+#include "./time/histogram.h"
+
+#endif  // SRC_HISTOGRAM_H_
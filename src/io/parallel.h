@@ -0,0 +1,100 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_IO_PARALLEL_H_
+#define SRC_IO_PARALLEL_H_
+
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "./serialize.h"
+#include "./stringify.h"
+#include "../concurrency/pool.h"
+
+namespace flow {
+namespace io {
+
+// Minimum number of elements per parallel chunk, smaller containers are
+// processed sequentially.
+static const size_t kMinParallelGrain = 1024;
+
+// Calls func(chunk, first, count) for consecutive chunks of the container in
+// parallel, with first being the iterator to the chunk's first element.
+// Returns the number of chunks.
+template<typename Container, typename Func>
+size_t ForEachChunk(const Container& con, Func func,
+                    flow::concurrency::ThreadPool& pool) {  // NOLINT
+  const size_t n = con.size();
+  size_t grain = flow::concurrency::GrainSize(n, pool.NumThreads());
+  grain = grain > kMinParallelGrain ? grain : kMinParallelGrain;
+  const size_t num_chunks = n > 0 ? (n + grain - 1) / grain : 0;
+  std::vector<typename Container::const_iterator> firsts;
+  firsts.reserve(num_chunks);
+  auto it = con.begin();
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    firsts.push_back(it);
+    if (chunk + 1 < num_chunks) {
+      std::advance(it, grain);
+    }
+  }
+  flow::concurrency::ParallelFor(pool, 0, num_chunks, [&](size_t chunk) {
+    const size_t count = chunk + 1 < num_chunks ? grain : n - chunk * grain;
+    func(chunk, firsts[chunk], count);
+  }, 1);
+  return num_chunks;
+}
+
+// Returns the same string representation as Str for the given container, with
+// the elements converted in parallel chunks.
+template<typename Container>
+std::string ParallelStr(const Container& con,
+    flow::concurrency::ThreadPool& pool,  // NOLINT
+    const std::string& delim = flow::io::Stringify::delim,
+    const std::string& wrap_start = flow::io::Stringify::wrap_start,
+    const std::string& wrap_end = flow::io::Stringify::wrap_end) {
+  std::vector<std::string> parts((con.size() + kMinParallelGrain - 1) /
+                                 kMinParallelGrain);
+  const size_t num_chunks = ForEachChunk(con,
+      [&](size_t chunk, typename Container::const_iterator it, size_t count) {
+    std::ostringstream ss;
+    ss << Str(*it, delim, wrap_start, wrap_end);
+    while (--count) {
+      ss << delim << Str(*++it, delim, wrap_start, wrap_end);
+    }
+    parts[chunk] = ss.str();
+  }, pool);
+  std::string str = wrap_start;
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    if (chunk) {
+      str += delim;
+    }
+    str += parts[chunk];
+  }
+  return str + wrap_end;
+}
+
+// Writes the given container to the stream in the same format as Write, with
+// the elements serialized in parallel chunks.
+template<typename Container>
+void ParallelWrite(const Container& con, std::ostream& stream,  // NOLINT
+                   flow::concurrency::ThreadPool& pool) {  // NOLINT
+  const uint64_t n = con.size();
+  Write(n, stream);
+  std::vector<std::string> parts((con.size() + kMinParallelGrain - 1) /
+                                 kMinParallelGrain);
+  const size_t num_chunks = ForEachChunk(con,
+      [&](size_t chunk, typename Container::const_iterator it, size_t count) {
+    std::ostringstream ss;
+    for (; count; --count, ++it) {
+      Write(*it, ss);
+    }
+    parts[chunk] = ss.str();
+  }, pool);
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    stream.write(parts[chunk].data(), parts[chunk].size());
+  }
+}
+
+}  // namespace io
+}  // namespace flow
+#endif  // SRC_IO_PARALLEL_H_
@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_METER_H_
+#define SRC_METER_H_
+
+#include "./time/meter.h"
+
+#endif  // SRC_METER_H_
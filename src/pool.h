@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_POOL_H_
+#define SRC_POOL_H_
+
+#include "./concurrency/pool.h"
+
+#endif  // SRC_POOL_H_
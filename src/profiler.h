@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_PROFILER_H_
+#define SRC_PROFILER_H_
+
+#include "./time/profiler.h"
+
+#endif  // SRC_PROFILER_H_
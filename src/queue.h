@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_QUEUE_H_
+#define SRC_QUEUE_H_
+
+#include "./concurrency/queue.h"
+
+#endif  // SRC_QUEUE_H_
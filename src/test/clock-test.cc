@@ -0,0 +1,114 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <sstream>
+#include "../time/clock.h"
+#include "../time/counters.h"
+
+using std::string;
+using std::stringstream;
+
+using namespace flow::time;  // NOLINT
+
+TEST(ClockDiffTest, units) {
+  ClockDiff diff = ClockDiff::FromNanos(1234567890);
+  EXPECT_EQ(1234567890, diff.Nanos());
+  EXPECT_EQ(1234567, diff.Micros());
+  EXPECT_EQ(1234, diff.Millis());
+  EXPECT_EQ(1, diff.Secs());
+  EXPECT_DOUBLE_EQ(1234567.89, diff.Micros<double>());
+  EXPECT_DOUBLE_EQ(1234.56789, diff.Millis<double>());
+  EXPECT_DOUBLE_EQ(1.23456789, diff.Secs<double>());
+
+  EXPECT_EQ(ClockDiff::FromNanos(2000), ClockDiff::FromMicros(2));
+  EXPECT_EQ(ClockDiff::FromMicros(2000), ClockDiff::FromMillis(2));
+  EXPECT_EQ(ClockDiff::FromMillis(2000), ClockDiff::FromSecs(2));
+}
+
+TEST(ClockDiffTest, value) {
+  ClockDiff diff(12);
+  EXPECT_EQ(12, diff.Value());
+  EXPECT_EQ(12000, diff.Nanos());
+  EXPECT_EQ(0, ClockDiff::FromNanos(999).Value());
+  EXPECT_EQ(1, ClockDiff::FromNanos(1999).Value());
+  EXPECT_EQ(30, (ClockDiff(10) + ClockDiff(20)).Value());
+  EXPECT_EQ(5, (ClockDiff(10) / 2).Value());
+  EXPECT_EQ(20, (ClockDiff(10) * 2).Value());
+  EXPECT_EQ(5, (ClockDiff(10) / ClockDiff(2)).Value());
+  EXPECT_EQ(20, (ClockDiff(10) * ClockDiff(2)).Value());
+  EXPECT_EQ(25000000000000, (ClockDiff(5000000) * ClockDiff(5000000)).Value());
+  EXPECT_EQ(2500, (ClockDiff(5000000) / ClockDiff(2000)).Value());
+  EXPECT_EQ(3750, (ClockDiff::FromNanos(1500) *
+                   ClockDiff::FromNanos(2500)).Nanos());
+  EXPECT_EQ(3750, (ClockDiff::FromNanos(2500) *
+                   ClockDiff::FromNanos(1500)).Nanos());
+}
+
+TEST(ClockDiffTest, chrono) {
+  ClockDiff diff = std::chrono::microseconds(1500);
+  EXPECT_EQ(1500000, diff.Nanos());
+  EXPECT_EQ(std::chrono::nanoseconds(1500000), diff.ToDuration());
+  EXPECT_EQ(std::chrono::milliseconds(1),
+            diff.ToDuration<std::chrono::milliseconds>());
+  EXPECT_EQ(ClockDiff::FromSecs(3), ClockDiff(std::chrono::seconds(3)));
+}
+
+TEST(ClockDiffTest, Str) {
+  EXPECT_EQ("0ns", ClockDiff().Str());
+  EXPECT_EQ("512ns", ClockDiff::FromNanos(512).Str());
+  EXPECT_EQ("1.50µs", ClockDiff::FromNanos(1500).Str());
+  EXPECT_EQ("2.25ms", ClockDiff::FromMicros(2250).Str());
+  EXPECT_EQ("3.00s", ClockDiff::FromSecs(3).Str());
+  EXPECT_EQ("2.00min", ClockDiff::FromSecs(120).Str());
+  stringstream ss;
+  ss << ClockDiff::FromNanos(42);
+  EXPECT_EQ("42ns", ss.str());
+}
+
+TEST(RateStrTest, prefixes) {
+  EXPECT_EQ("12.00 ops/s", RateStr(12.0, "ops"));
+  EXPECT_EQ("1.50 kB/s", RateStr(1500.0, "B"));
+  EXPECT_EQ("2.00 MiB/s", RateStr(2.0 * 1024 * 1024, "B", true));
+}
+
+TEST(ClockTest, diff) {
+  Clock begin;
+  Clock end;
+  EXPECT_GE((end - begin).Nanos(), 0);
+  EXPECT_GT(Clock::Resolution(Clock::kRealMonotonic).Nanos(), 0);
+}
+
+TEST(CounterClockTest, diff) {
+  CounterClock begin;
+  int64_t sum = 0;
+  for (int64_t i = 0; i < 100000; ++i) {
+    sum += i * i;
+  }
+  EXPECT_GT(sum, 0);
+  CounterDiff diff = CounterClock() - begin;
+  EXPECT_GT(diff.Time(), ClockDiff());
+  EXPECT_EQ(CounterClock::Available(), diff.HasCounters());
+  if (diff.HasCounters()) {
+    EXPECT_GT(diff.Events(kCycles), 0);
+    EXPECT_GT(diff.Events(kInstructions), 0);
+    EXPECT_GT(diff.Ipc(), 0.0);
+    EXPECT_NE(string::npos, diff.Str().find(" IPC "));
+  } else {
+    // Degrades to time only.
+    EXPECT_EQ(diff.Time().Str(), diff.Str());
+    EXPECT_EQ(0, diff.Events(kCycles));
+  }
+}
+
+TEST(CounterDiffTest, Str) {
+  const int64_t events[kNumCounterEvents] = {2000000, 3000000, 500, 40};
+  CounterDiff diff(ClockDiff::FromMillis(1), events, true);
+  EXPECT_DOUBLE_EQ(1.5, diff.Ipc());
+  EXPECT_EQ("1.00ms 1.50 IPC 2.00M cycles 3.00M instructions 500 cache-misses "
+            "40 branch-misses", diff.Str());
+  EXPECT_EQ("10.00µs/item 1.50 IPC 20.00k cycles/item 30.00k instructions/item"
+            " 5 cache-misses/item 0.40 branch-misses/item", diff.Str(100));
+  diff += diff;
+  EXPECT_EQ(ClockDiff::FromMillis(2), diff.Time());
+  EXPECT_EQ(4000000, diff.Events(kCycles));
+}
@@ -0,0 +1,155 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../time/histogram.h"
+
+using std::string;
+using std::stringstream;
+using std::thread;
+using std::vector;
+
+using namespace flow::time;  // NOLINT
+
+TEST(HistogramLayoutTest, buckets) {
+  HistogramLayout layout(ClockDiff::FromSecs(60), 2);
+  EXPECT_EQ(8, layout.Bits());
+  for (int64_t v = 0; v < 256; ++v) {
+    ASSERT_EQ(static_cast<size_t>(v), layout.Index(v));
+    ASSERT_EQ(v, layout.Lowest(v));
+    ASSERT_EQ(v, layout.Highest(v));
+  }
+  for (int64_t v = 1; v < layout.Max(); v = v * 3 + 1) {
+    const size_t index = layout.Index(v);
+    ASSERT_LE(layout.Lowest(index), v);
+    ASSERT_GE(layout.Highest(index), v);
+    // The bucket width is bounded by the relative precision.
+    ASSERT_LE(layout.Highest(index) - layout.Lowest(index), v / 100);
+  }
+  EXPECT_EQ(layout.Size() - 1, layout.Index(layout.Max()));
+  EXPECT_EQ(layout.Size() - 1, layout.Index(layout.Max() * 2));
+}
+
+TEST(HistogramTest, percentiles) {
+  Histogram histogram(ClockDiff::FromSecs(1), 3);
+  for (int i = 1; i <= 10000; ++i) {
+    histogram.Record(ClockDiff::FromNanos(i * 100));
+  }
+  HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(10000u, snapshot.Count());
+  EXPECT_EQ(ClockDiff::FromNanos(100), snapshot.Min());
+  EXPECT_EQ(ClockDiff::FromNanos(1000000), snapshot.Max());
+  EXPECT_EQ(ClockDiff::FromNanos(500050), snapshot.Mean());
+  EXPECT_NEAR(500000, snapshot.Percentile(50.0).Nanos(), 500);
+  EXPECT_NEAR(990000, snapshot.Percentile(99.0).Nanos(), 990);
+  EXPECT_NEAR(999000, snapshot.Percentile(99.9).Nanos(), 999);
+  EXPECT_EQ(snapshot.Max(), snapshot.Percentile(100.0));
+  EXPECT_EQ(snapshot.Min(), snapshot.Percentile(0.0));
+  EXPECT_NE(string::npos, snapshot.Str().find("count 10000 mean 500.05µs"));
+
+  histogram.Reset();
+  EXPECT_EQ(0u, histogram.Snapshot().Count());
+  EXPECT_EQ(ClockDiff(), histogram.Snapshot().Percentile(50.0));
+}
+
+TEST(HistogramTest, clamp) {
+  Histogram histogram(ClockDiff::FromMicros(10));
+  histogram.Record(ClockDiff::FromNanos(-5));
+  histogram.Record(ClockDiff::FromSecs(1));
+  HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(ClockDiff(), snapshot.Min());
+  EXPECT_EQ(ClockDiff::FromMicros(10), snapshot.Max());
+}
+
+TEST(HistogramTest, threads) {
+  Histogram histogram;
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(thread([&histogram]() {
+      for (int i = 0; i < 10000; ++i) {
+        histogram.Record(ClockDiff::FromNanos(i));
+      }
+    }));
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+  HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(40000u, snapshot.Count());
+  EXPECT_EQ(ClockDiff::FromNanos(9999), snapshot.Max());
+}
+
+TEST(HistogramTest, merge) {
+  Histogram a;
+  Histogram b;
+  for (int i = 0; i < 100; ++i) {
+    a.Record(ClockDiff::FromMicros(1));
+    b.Record(ClockDiff::FromMillis(1));
+  }
+  HistogramSnapshot merged;
+  EXPECT_TRUE(merged.Merge(a.Snapshot()));
+  EXPECT_TRUE(merged.Merge(b.Snapshot()));
+  EXPECT_EQ(200u, merged.Count());
+  EXPECT_EQ(ClockDiff::FromMicros(1), merged.Min());
+  EXPECT_EQ(ClockDiff::FromMillis(1), merged.Max());
+  EXPECT_NEAR(1000, merged.Percentile(50.0).Nanos(), 10);
+  EXPECT_NEAR(1000000, merged.Percentile(51.0).Nanos(), 10000);
+
+  Histogram other(ClockDiff::FromSecs(1), 3);
+  other.Record(ClockDiff::FromMicros(5));
+  EXPECT_FALSE(merged.Merge(other.Snapshot()));
+  EXPECT_EQ(200u, merged.Count());
+}
+
+TEST(HistogramTest, serialize) {
+  Histogram histogram(ClockDiff::FromSecs(10), 3);
+  for (int i = 0; i < 1000; ++i) {
+    histogram.Record(ClockDiff::FromNanos(i * i));
+  }
+  const HistogramSnapshot snapshot = histogram.Snapshot();
+  stringstream stream;
+  flow::io::Write(snapshot, stream);
+  HistogramSnapshot read;
+  flow::io::Read(stream, &read);
+  EXPECT_TRUE(snapshot.Layout() == read.Layout());
+  EXPECT_EQ(snapshot.Counts(), read.Counts());
+  EXPECT_EQ(snapshot.Count(), read.Count());
+  EXPECT_EQ(snapshot.Sum(), read.Sum());
+  EXPECT_EQ(snapshot.Min(), read.Min());
+  EXPECT_EQ(snapshot.Max(), read.Max());
+  EXPECT_EQ(snapshot.Str(), read.Str());
+}
+
+TEST(HistogramTest, serializeVector) {
+  vector<HistogramSnapshot> snapshots;
+  for (int h = 1; h <= 3; ++h) {
+    Histogram histogram(ClockDiff::FromSecs(h), h);
+    for (int i = 0; i < 100 * h; ++i) {
+      histogram.Record(ClockDiff::FromMicros(i));
+    }
+    snapshots.push_back(histogram.Snapshot());
+  }
+  stringstream stream;
+  flow::io::Write(snapshots, stream);
+  vector<HistogramSnapshot> read;
+  flow::io::Read(stream, &read);
+  ASSERT_EQ(snapshots.size(), read.size());
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    EXPECT_TRUE(snapshots[i].Layout() == read[i].Layout());
+    EXPECT_EQ(snapshots[i].Counts(), read[i].Counts());
+    EXPECT_EQ(snapshots[i].Str(), read[i].Str());
+  }
+}
+
+TEST(HistogramTest, serializeInvalid) {
+  stringstream stream;
+  flow::io::Write(int32_t(64), stream);
+  flow::io::Write(int64_t(1000), stream);
+  HistogramSnapshot read;
+  flow::io::Read(stream, &read);
+  EXPECT_TRUE(stream.fail());
+  EXPECT_EQ(0u, read.Count());
+  EXPECT_TRUE(read.Counts().empty());
+}
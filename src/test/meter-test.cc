@@ -0,0 +1,97 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../time/meter.h"
+
+using std::string;
+using std::thread;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+using namespace flow::time;  // NOLINT
+
+TEST(MeterTest, rates) {
+  const ClockDiff start = ClockDiff::FromSecs(1000);
+  Meter meter("ops", start);
+  // 100 events per second for 2 minutes.
+  for (int s = 1; s <= 120; ++s) {
+    meter.Mark(100);
+    meter.Snapshot(start + ClockDiff::FromSecs(s));
+  }
+  MeterSnapshot snapshot = meter.Snapshot(start + ClockDiff::FromSecs(120));
+  EXPECT_EQ(12000, snapshot.count);
+  EXPECT_DOUBLE_EQ(100.0, snapshot.mean);
+  EXPECT_DOUBLE_EQ(100.0, snapshot.instant);
+  EXPECT_DOUBLE_EQ(100.0, snapshot.window);
+  EXPECT_NEAR(100.0 * (1.0 - std::exp(-2.0)), snapshot.m1, 1e-6);
+  EXPECT_NEAR(100.0 * (1.0 - std::exp(-120.0 / 300.0)), snapshot.m5, 1e-6);
+  EXPECT_NEAR(100.0 * (1.0 - std::exp(-120.0 / 900.0)), snapshot.m15, 1e-6);
+  EXPECT_EQ("12000 ops, 100.00 ops/s (mean 100.00 ops/s, window 100.00 ops/s,"
+            " 1m 86.47 ops/s, 5m 32.97 ops/s, 15m 12.48 ops/s)",
+            snapshot.Str());
+}
+
+TEST(MeterTest, catchup) {
+  const ClockDiff start = ClockDiff::FromSecs(0);
+  Meter meter("B", start);
+  meter.Mark(3000);
+  // Events of missed ticks are spread evenly.
+  MeterSnapshot snapshot = meter.Snapshot(ClockDiff::FromMillis(30500));
+  EXPECT_DOUBLE_EQ(100.0, snapshot.instant);
+  EXPECT_DOUBLE_EQ(100.0, snapshot.window);
+  // Idle ticks decay the rates.
+  snapshot = meter.Snapshot(ClockDiff::FromSecs(120));
+  EXPECT_DOUBLE_EQ(0.0, snapshot.instant);
+  EXPECT_DOUBLE_EQ(0.0, snapshot.window);
+  EXPECT_GT(snapshot.m1, 0.0);
+  EXPECT_LT(snapshot.m1, 10.0);
+  EXPECT_DOUBLE_EQ(25.0, snapshot.mean);
+}
+
+TEST(MeterTest, threads) {
+  Meter meter;
+  vector<thread> threads;
+  for (int t = 0; t < 32; ++t) {
+    threads.push_back(thread([&meter]() {
+      for (int i = 0; i < 10000; ++i) {
+        meter.Mark();
+      }
+    }));
+  }
+  for (int i = 0; i < 100; ++i) {
+    meter.Snapshot();
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+  EXPECT_EQ(320000, meter.Count());
+  EXPECT_EQ(320000, meter.Snapshot().count);
+}
+
+TEST(MeterTest, Str) {
+  const ClockDiff start = ClockDiff::FromSecs(1000);
+  Meter meter("B", start);
+  meter.Mark(1500);
+  const MeterSnapshot snapshot = meter.Snapshot(start + ClockDiff::FromSecs(1));
+  EXPECT_EQ(0u, snapshot.Str().find("1500 B, 1.50 kB/s (mean 1.50 kB/s,"));
+}
+
+TEST(MeterTest, shared) {
+  shared_ptr<Meter> meter = make_shared<Meter>();
+  vector<thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(thread([meter]() {
+      for (int j = 0; j < 1000; ++j) {
+        meter->Mark();
+      }
+    }));
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+  EXPECT_EQ(4000, meter->Count());
+}
@@ -0,0 +1,152 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../concurrency/pool.h"
+#include "../io/parallel.h"
+#include "../time/clock.h"
+
+using std::atomic;
+using std::future;
+using std::map;
+using std::runtime_error;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+using namespace flow::concurrency;  // NOLINT
+
+TEST(ThreadPoolTest, Submit) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4u, pool.NumThreads());
+  vector<future<int> > futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(pool.Submit([](int a, int b) { return a * b; }, i, 2));
+  }
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(2 * i, futures[i].get());
+  }
+  future<void> error = pool.Submit([]() { throw runtime_error("error"); });
+  EXPECT_THROW(error.get(), runtime_error);
+}
+
+TEST(ThreadPoolTest, drain) {
+  atomic<int> count(0);
+  {
+    ThreadPool pool(2);
+    for (int i = 0; i < 1000; ++i) {
+      pool.Post([&count]() { ++count; });
+    }
+  }
+  EXPECT_EQ(1000, count.load());
+}
+
+TEST(ThreadPoolTest, ParallelFor) {
+  ThreadPool pool(4);
+  vector<int> values(100000, 0);
+  ParallelFor(pool, 0, values.size(), [&values](size_t i) {
+    values[i] = static_cast<int>(i);
+  });
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(static_cast<int>(i), values[i]);
+  }
+  atomic<int> count(0);
+  ParallelFor(pool, 10, 10, [&count](size_t i) { ++count; });
+  ParallelFor(pool, 10, 11, [&count](size_t i) { ++count; });
+  ParallelFor(pool, 0, 1000, [&count](size_t i) { ++count; }, 7);
+  EXPECT_EQ(1001, count.load());
+  EXPECT_THROW(ParallelFor(pool, 0, 1000, [](size_t i) {
+    if (i == 500) {
+      throw runtime_error("error");
+    }
+  }), runtime_error);
+}
+
+TEST(ThreadPoolTest, nested) {
+  ThreadPool pool(2);
+  atomic<int> count(0);
+  ParallelFor(pool, 0, 16, [&pool, &count](size_t i) {
+    ParallelFor(pool, 0, 100, [&count](size_t j) { ++count; }, 10);
+  }, 1);
+  EXPECT_EQ(1600, count.load());
+}
+
+TEST(ThreadPoolTest, park) {
+  ThreadPool pool(2);
+  const flow::time::ThreadClock begin;
+  // The calling thread parks while the other chunks sleep.
+  ParallelFor(pool, 0, 3, [](size_t i) {
+    if (i > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+  }, 1);
+  EXPECT_LT((flow::time::ThreadClock() - begin).Millis(), 100);
+}
+
+TEST(ThreadPoolTest, ParallelReduce) {
+  ThreadPool pool(4);
+  const int64_t sum = ParallelReduce(pool, 0, 1000001, int64_t(0),
+      [](size_t b, size_t e) {
+        int64_t partial = 0;
+        for (size_t i = b; i < e; ++i) {
+          partial += i;
+        }
+        return partial;
+      }, [](int64_t a, int64_t b) { return a + b; });
+  EXPECT_EQ(500000500000, sum);
+  // Partial results are combined in order.
+  const string str = ParallelReduce(pool, 0, 26, string(),
+      [](size_t b, size_t e) {
+        string partial;
+        for (size_t i = b; i < e; ++i) {
+          partial += static_cast<char>('a' + i);
+        }
+        return partial;
+      }, [](const string& a, const string& b) { return a + b; }, 3);
+  EXPECT_EQ("abcdefghijklmnopqrstuvwxyz", str);
+  EXPECT_EQ(7, ParallelReduce(pool, 5, 5, 7, [](size_t b, size_t e) {
+    return 0;
+  }, [](int a, int b) { return a + b; }));
+}
+
+TEST(ThreadPoolTest, ParallelStr) {
+  ThreadPool pool(4);
+  vector<int> vec;
+  EXPECT_EQ(flow::io::Str(vec), flow::io::ParallelStr(vec, pool));
+  for (int i = 0; i < 10000; ++i) {
+    vec.push_back(i);
+  }
+  EXPECT_EQ(flow::io::Str(vec), flow::io::ParallelStr(vec, pool));
+  EXPECT_EQ(flow::io::Str(vec, "; ", "[", "]"),
+            flow::io::ParallelStr(vec, pool, "; ", "[", "]"));
+  map<int, vector<int> > m;
+  for (int i = 0; i < 3000; ++i) {
+    m[i] = vector<int>(i % 3, i);
+  }
+  EXPECT_EQ(flow::io::Str(m), flow::io::ParallelStr(m, pool));
+}
+
+TEST(ThreadPoolTest, ParallelWrite) {
+  ThreadPool pool(4);
+  vector<string> vec;
+  for (int i = 0; i < 5000; ++i) {
+    stringstream ss;
+    ss << "value-" << i;
+    vec.push_back(ss.str());
+  }
+  stringstream serial;
+  flow::io::Write(vec, serial);
+  stringstream parallel;
+  flow::io::ParallelWrite(vec, parallel, pool);
+  EXPECT_EQ(serial.str(), parallel.str());
+  vector<string> read;
+  flow::io::Read(parallel, &read);
+  EXPECT_EQ(vec, read);
+}
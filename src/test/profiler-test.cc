@@ -0,0 +1,150 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../time/profiler.h"
+
+using std::string;
+using std::vector;
+using std::thread;
+
+using namespace flow::time;  // NOLINT
+
+namespace {
+
+void Leaf() {
+  FLOW_PROFILE_SCOPE("leaf");
+}
+
+void Inner(int n) {
+  FLOW_PROFILE_SCOPE("inner");
+  for (int i = 0; i < n; ++i) {
+    Leaf();
+  }
+}
+
+void Outer(int n) {
+  FLOW_PROFILE_SCOPE("outer");
+  Inner(n);
+}
+
+}  // namespace
+
+TEST(ProfilerTest, tree) {
+  Profiler::Reset();
+  Outer(10);
+  Outer(5);
+  ProfileReport report = Profiler::Report();
+  const ProfileEntry* outer = report.Find({"outer"});
+  ASSERT_TRUE(outer != nullptr);
+  EXPECT_EQ(2, outer->count);
+  const ProfileEntry* inner = report.Find({"outer", "inner"});
+  ASSERT_TRUE(inner != nullptr);
+  EXPECT_EQ(2, inner->count);
+  const ProfileEntry* leaf = report.Find({"outer", "inner", "leaf"});
+  ASSERT_TRUE(leaf != nullptr);
+  EXPECT_EQ(15, leaf->count);
+  EXPECT_TRUE(report.Find({"inner"}) == nullptr);
+  EXPECT_TRUE(report.Find({"outer", "leaf"}) == nullptr);
+
+  EXPECT_GE(outer->total[kProfileWall], inner->total[kProfileWall]);
+  EXPECT_EQ(outer->total[kProfileWall] - inner->total[kProfileWall],
+            outer->self[kProfileWall]);
+  EXPECT_LE(leaf->min[kProfileWall], leaf->max[kProfileWall]);
+  EXPECT_EQ(ClockDiff(), leaf->total[kProfileThread]);
+  EXPECT_NE(string::npos, report.Str().find("    leaf: 15x"));
+}
+
+TEST(ProfilerTest, threads) {
+  Profiler::Reset();
+  Profiler::EnableCpuClocks(true);
+  vector<thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(thread([]() {
+      FLOW_PROFILE_SCOPE("worker");
+      for (int j = 0; j < 100; ++j) {
+        Leaf();
+      }
+    }));
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+  Profiler::EnableCpuClocks(false);
+  ProfileReport report = Profiler::Report();
+  const ProfileEntry* worker = report.Find({"worker"});
+  ASSERT_TRUE(worker != nullptr);
+  EXPECT_EQ(4, worker->count);
+  const ProfileEntry* leaf = report.Find({"worker", "leaf"});
+  ASSERT_TRUE(leaf != nullptr);
+  EXPECT_EQ(400, leaf->count);
+  EXPECT_GT(worker->total[kProfileThread], ClockDiff());
+  EXPECT_GT(worker->total[kProfileProcess], ClockDiff());
+}
+
+TEST(ProfilerTest, reset) {
+  Profiler::Reset();
+  Outer(3);
+  const size_t num_profiles = internal::Registry().profiles.size();
+  thread worker([]() { Outer(2); });
+  worker.join();
+  // The exited thread's profile is merged and unregistered.
+  EXPECT_EQ(num_profiles, internal::Registry().profiles.size());
+  ProfileReport report = Profiler::Report();
+  ASSERT_TRUE(report.Find({"outer", "inner", "leaf"}) != nullptr);
+  EXPECT_EQ(2, report.Find({"outer"})->count);
+  EXPECT_EQ(5, report.Find({"outer", "inner", "leaf"})->count);
+  Profiler::Reset();
+  EXPECT_TRUE(Profiler::Report().roots.empty());
+  Outer(1);
+  EXPECT_EQ(1, Profiler::Report().Find({"outer", "inner", "leaf"})->count);
+}
+
+TEST(ProfilerTest, concurrent_reset) {
+  Profiler::Reset();
+  std::atomic<bool> stop(false);
+  std::atomic<int64_t> iterations(0);
+  thread worker([&stop, &iterations]() {
+    while (!stop.load()) {
+      Leaf();
+      iterations.fetch_add(1);
+    }
+  });
+  for (int i = 0; i < 100; ++i) {
+    const int64_t begin = iterations.load();
+    Profiler::Reset();
+    while (iterations.load() < begin + 10) {
+      std::this_thread::yield();
+    }
+    const ProfileReport report = Profiler::Report();
+    const int64_t end = iterations.load();
+    const ProfileEntry* leaf = report.Find({"leaf"});
+    // At most the section running during the reset is partially counted.
+    if (leaf != nullptr) {
+      EXPECT_LE(leaf->count, end - begin + 1);
+    }
+  }
+  stop.store(true);
+  worker.join();
+}
+
+TEST(ProfilerTest, counters) {
+  Profiler::Reset();
+  Profiler::EnableCounters(true);
+  {
+    FLOW_PROFILE_SCOPE("counted");
+    Inner(10);
+  }
+  Profiler::EnableCounters(false);
+  ProfileReport report = Profiler::Report();
+  const ProfileEntry* counted = report.Find({"counted"});
+  ASSERT_TRUE(counted != nullptr);
+  EXPECT_EQ(1, counted->count);
+  EXPECT_EQ(CounterClock::Available(), counted->counters.HasCounters());
+  if (counted->counters.HasCounters()) {
+    EXPECT_GT(counted->counters.Events(kInstructions), 0);
+    EXPECT_NE(string::npos, report.Str().find(" IPC "));
+  }
+}
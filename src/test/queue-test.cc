@@ -0,0 +1,261 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../concurrency/queue.h"
+
+using std::atomic;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+using namespace flow::concurrency;  // NOLINT
+
+namespace {
+
+// Counts the live instances to detect leaked or double-destroyed items.
+struct Tracked {
+  Tracked() : value(0) { ++live; }
+  explicit Tracked(int v) : value(v) { ++live; }
+  Tracked(const Tracked& other) : value(other.value) { ++live; }
+  Tracked& operator=(const Tracked& other) {
+    value = other.value;
+    return *this;
+  }
+  ~Tracked() { --live; }
+
+  int value;
+  static int live;
+};
+
+int Tracked::live = 0;
+
+// Pushes num_items sequence numbers tagged with the producer id from each
+// producer and checks that every consumer sees each producer's items in order
+// and that all items are consumed exactly once.
+template<typename Queue>
+void Stress(Queue* queue, int num_producers, int num_consumers,
+            int64_t num_items) {
+  const int64_t kShift = 40;
+  atomic<int64_t> sum(0);
+  atomic<int64_t> count(0);
+  atomic<bool> ordered(true);
+  vector<thread> threads;
+  for (int p = 0; p < num_producers; ++p) {
+    threads.push_back(thread([=]() {
+      for (int64_t i = 0; i < num_items; ++i) {
+        while (!queue->TryPush((int64_t(p) << kShift) | i)) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+  const int64_t total = num_producers * num_items;
+  for (int c = 0; c < num_consumers; ++c) {
+    threads.push_back(thread([&, num_producers]() {
+      vector<int64_t> last(num_producers, -1);
+      int64_t items[16];
+      while (count.load() < total) {
+        const size_t n = queue->TryPopBatch(items, 16);
+        if (n == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (size_t k = 0; k < n; ++k) {
+          const int p = static_cast<int>(items[k] >> kShift);
+          const int64_t i = items[k] & ((int64_t(1) << kShift) - 1);
+          if (i <= last[p]) {
+            ordered = false;
+          }
+          last[p] = i;
+          sum += i;
+        }
+        count += n;
+      }
+    }));
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+  EXPECT_TRUE(ordered.load());
+  EXPECT_EQ(total, count.load());
+  EXPECT_EQ(num_producers * (num_items * (num_items - 1) / 2), sum.load());
+}
+
+}  // namespace
+
+TEST(SpscQueueTest, TryPushPop) {
+  SpscQueue<int> queue(5);
+  EXPECT_EQ(8u, queue.Capacity());
+  int value = -1;
+  EXPECT_FALSE(queue.TryPop(&value));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.TryPush(i));
+  }
+  EXPECT_FALSE(queue.TryPush(8));
+  EXPECT_EQ(8u, queue.SizeApprox());
+  for (int round = 0; round < 100; ++round) {
+    EXPECT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(round, value);
+    EXPECT_TRUE(queue.TryPush(round + 8));
+  }
+  int values[16];
+  EXPECT_EQ(8u, queue.TryPopBatch(values, 16));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(100 + i, values[i]);
+  }
+  for (int i = 0; i < 16; ++i) {
+    values[i] = i;
+  }
+  EXPECT_EQ(8u, queue.TryPushBatch(values, 16));
+  EXPECT_EQ(0u, queue.TryPushBatch(values, 1));
+  EXPECT_EQ(3u, queue.TryPopBatch(values, 3));
+  EXPECT_EQ(2, values[2]);
+  EXPECT_EQ(5u, queue.SizeApprox());
+}
+
+TEST(SpscQueueTest, Lifetime) {
+  {
+    SpscQueue<Tracked> queue(4);
+    Tracked item(1);
+    EXPECT_TRUE(queue.TryPush(item));
+    EXPECT_TRUE(queue.TryPush(Tracked(2)));
+    EXPECT_EQ(3, Tracked::live);
+    EXPECT_TRUE(queue.TryPop(&item));
+    EXPECT_EQ(2, Tracked::live);
+  }
+  EXPECT_EQ(0, Tracked::live);
+  SpscQueue<unique_ptr<int> > queue(2);
+  EXPECT_TRUE(queue.TryPush(unique_ptr<int>(new int(7))));
+  unique_ptr<int> ptr;
+  EXPECT_TRUE(queue.TryPop(&ptr));
+  EXPECT_EQ(7, *ptr);
+}
+
+TEST(SpscQueueTest, Stress) {
+  SpscQueue<int64_t> queue(64);
+  Stress(&queue, 1, 1, 200000);
+}
+
+TEST(MpmcQueueTest, TryPushPop) {
+  MpmcQueue<int> queue(3);
+  EXPECT_EQ(4u, queue.Capacity());
+  int value = -1;
+  EXPECT_FALSE(queue.TryPop(&value));
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(queue.TryPush(round * 4 + i));
+    }
+    EXPECT_FALSE(queue.TryPush(-1));
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(queue.TryPop(&value));
+      EXPECT_EQ(round * 4 + i, value);
+    }
+    EXPECT_FALSE(queue.TryPop(&value));
+  }
+  int values[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+  EXPECT_EQ(4u, queue.TryPushBatch(values, 8));
+  EXPECT_EQ(4u, queue.SizeApprox());
+  EXPECT_EQ(4u, queue.TryPopBatch(values + 4, 8));
+  EXPECT_EQ(3, values[7]);
+}
+
+TEST(MpmcQueueTest, Lifetime) {
+  {
+    MpmcQueue<Tracked> queue(4);
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(queue.TryPush(Tracked(i)));
+    }
+    Tracked item;
+    EXPECT_TRUE(queue.TryPop(&item));
+    EXPECT_EQ(0, item.value);
+    EXPECT_EQ(3, Tracked::live);
+  }
+  EXPECT_EQ(0, Tracked::live);
+}
+
+TEST(MpmcQueueTest, Stress) {
+  MpmcQueue<int64_t> queue(64);
+  Stress(&queue, 4, 4, 50000);
+}
+
+TEST(BlockingQueueTest, Pipeline) {
+  BlockingQueue<SpscQueue<int> > stage1(4);
+  BlockingQueue<MpmcQueue<int> > stage2(4);
+  const int kNumItems = 10000;
+  thread producer([&]() {
+    for (int i = 0; i < kNumItems; ++i) {
+      EXPECT_TRUE(stage1.Push(i));
+    }
+    stage1.Close();
+  });
+  thread mapper([&]() {
+    int item;
+    while (stage1.Pop(&item)) {
+      EXPECT_TRUE(stage2.Push(2 * item));
+    }
+    stage2.Close();
+  });
+  atomic<int64_t> sum(0);
+  atomic<int> count(0);
+  vector<thread> consumers;
+  for (int c = 0; c < 3; ++c) {
+    consumers.push_back(thread([&]() {
+      int items[8];
+      size_t n;
+      while ((n = stage2.PopBatch(items, 8)) > 0) {
+        for (size_t k = 0; k < n; ++k) {
+          sum += items[k];
+        }
+        count += n;
+      }
+    }));
+  }
+  producer.join();
+  mapper.join();
+  for (auto& t: consumers) {
+    t.join();
+  }
+  EXPECT_EQ(kNumItems, count.load());
+  EXPECT_EQ(int64_t(kNumItems) * (kNumItems - 1), sum.load());
+  EXPECT_FALSE(stage2.Push(1));
+  int item;
+  EXPECT_FALSE(stage2.Pop(&item));
+}
+
+TEST(BlockingQueueTest, parked) {
+  BlockingQueue<MpmcQueue<int> > queue(16);
+  int items[4];
+  // Returns immediately on the empty, open queue.
+  EXPECT_EQ(0u, queue.PopBatch(items, 0));
+  const int kNumConsumers = 4;
+  const int kNumItems = 1000;
+  atomic<int> count(0);
+  vector<thread> consumers;
+  for (int c = 0; c < kNumConsumers; ++c) {
+    consumers.push_back(thread([&]() {
+      int item;
+      while (queue.Pop(&item)) {
+        ++count;
+      }
+    }));
+  }
+  for (int i = 0; i < kNumItems; ++i) {
+    EXPECT_TRUE(queue.Push(i));
+    if (i % 100 == 0) {
+      // Lets the consumers park.
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+  while (count.load() < kNumItems) {
+    std::this_thread::yield();
+  }
+  queue.Close();
+  for (auto& t: consumers) {
+    t.join();
+  }
+  EXPECT_EQ(kNumItems, count.load());
+}
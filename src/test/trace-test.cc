@@ -0,0 +1,93 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../time/trace.h"
+
+using std::string;
+using std::stringstream;
+using std::thread;
+using std::vector;
+
+using namespace flow::time;  // NOLINT
+
+namespace {
+
+// Returns the number of occurrences of the pattern in the string.
+int Count(const string& str, const string& pattern) {
+  int n = 0;
+  for (size_t pos = str.find(pattern); pos != string::npos;
+       pos = str.find(pattern, pos + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+// Returns the flushed trace JSON.
+string FlushedTrace() {
+  stringstream ss;
+  Tracer::Flush(ss);
+  return ss.str();
+}
+
+}  // namespace
+
+TEST(TracerTest, disabled) {
+  FlushedTrace();
+  Tracer::Enable(false);
+  {
+    FLOW_TRACE_SCOPE("disabled");
+  }
+  const string trace = FlushedTrace();
+  EXPECT_EQ(0, Count(trace, "\"disabled\""));
+  EXPECT_EQ(0u, trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+}
+
+TEST(TracerTest, spans) {
+  FlushedTrace();
+  const size_t num_buffers = internal::Tracing().buffers.size();
+  Tracer::Enable(true);
+  vector<thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(thread([]() {
+      Tracer::SetThreadName("worker \"w\"");
+      FLOW_TRACE_SCOPE("outer");
+      for (int j = 0; j < 10; ++j) {
+        FLOW_TRACE_SCOPE("inner");
+      }
+    }));
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+  Tracer::Enable(false);
+  const string trace = FlushedTrace();
+  EXPECT_EQ(4, Count(trace, "\"name\":\"outer\",\"ph\":\"X\""));
+  EXPECT_EQ(40, Count(trace, "\"name\":\"inner\",\"ph\":\"X\""));
+  EXPECT_EQ(4, Count(trace, "\"args\":{\"name\":\"worker \\\"w\\\"\"}"));
+  // Flushed spans are consumed, the buffers of exited threads released.
+  const string flushed = FlushedTrace();
+  EXPECT_EQ(0, Count(flushed, "\"ph\":\"X\""));
+  EXPECT_EQ(0, Count(flushed, "worker"));
+  EXPECT_EQ(num_buffers, internal::Tracing().buffers.size());
+}
+
+TEST(TracerTest, overwrite) {
+  Tracer::SetBufferSize(8);
+  thread t([]() {
+    for (int i = 0; i < 20; ++i) {
+      Tracer::Record("span", Clock::Now(), ClockDiff::FromNanos(1500));
+    }
+    stringstream ss;
+    EXPECT_EQ(12u, Tracer::Flush(ss));
+    const string trace = ss.str();
+    EXPECT_EQ(8, Count(trace, "\"name\":\"span\""));
+    EXPECT_NE(string::npos, trace.find("\"dur\":1.500,"));
+  });
+  t.join();
+  // Drained buffers are released on thread exit.
+  EXPECT_EQ(0, Count(FlushedTrace(), "\"name\":\"span\""));
+  Tracer::SetBufferSize(1 << 16);
+}
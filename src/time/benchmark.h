@@ -0,0 +1,489 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_BENCHMARK_H_
+#define SRC_TIME_BENCHMARK_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "./clock.h"
+#include "./counters.h"
+#include "./macros.h"
+
+namespace flow {
+namespace time {
+
+// Prevents the compiler from optimizing away the given value or the
+// computation leading to it.
+template<typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");  // NOLINT
+}
+
+// Forces the compiler to assume that all memory has been read and written.
+inline void ClobberMemory() {
+  asm volatile("" : : : "memory");  // NOLINT
+}
+
+// Per-run state passed to benchmark functions. The measured section is the
+// loop driven by KeepRunning, setup code before the loop is not measured:
+//
+//   void BM_Foo(BenchmarkState& state) {
+//     std::vector<int> input(state.Arg());
+//     while (state.KeepRunning()) {
+//       DoNotOptimize(Foo(input));
+//     }
+//     state.SetItemsProcessed(state.Iterations() * input.size());
+//   }
+class BenchmarkState {
+ public:
+  BenchmarkState(int64_t iterations, int64_t arg, bool counters)
+      : iterations_(iterations),
+        remaining_(iterations),
+        arg_(arg),
+        counters_(counters),
+        bytes_(0),
+        items_(0) {}
+
+  // Returns whether the next iteration should be run. The first call starts
+  // and the last call stops the measurement.
+  bool KeepRunning() {
+    if (remaining_ == iterations_) {
+      if (counters_) {
+        counters_ = CounterGroup::Local().Read(begin_events_);
+      }
+      begin_ = Clock::Now();
+    }
+    if (remaining_-- > 0) {
+      return true;
+    }
+    elapsed_ = Clock::Now() - begin_;
+    if (counters_) {
+      int64_t events[kNumCounterEvents];
+      CounterGroup::Local().Read(events);
+      for (int e = 0; e < kNumCounterEvents; ++e) {
+        events[e] -= begin_events_[e];
+      }
+      counters_diff_ = CounterDiff(elapsed_, events, true);
+    }
+    return false;
+  }
+
+  // Returns the number of iterations of this run.
+  int64_t Iterations() const {
+    return iterations_;
+  }
+
+  // Returns the argument the benchmark has been registered with.
+  int64_t Arg() const {
+    return arg_;
+  }
+
+  // Sets the total number of bytes processed in this run.
+  void SetBytesProcessed(int64_t bytes) {
+    bytes_ = bytes;
+  }
+
+  // Sets the total number of items processed in this run.
+  void SetItemsProcessed(int64_t items) {
+    items_ = items;
+  }
+
+  // Returns the measured duration of all iterations.
+  const ClockDiff& Elapsed() const {
+    return elapsed_;
+  }
+
+  // Returns the hardware events counted over all iterations, if enabled.
+  const CounterDiff& Counters() const {
+    return counters_diff_;
+  }
+
+  int64_t BytesProcessed() const {
+    return bytes_;
+  }
+
+  int64_t ItemsProcessed() const {
+    return items_;
+  }
+
+ private:
+  const int64_t iterations_;
+  int64_t remaining_;
+  const int64_t arg_;
+  bool counters_;
+  int64_t bytes_;
+  int64_t items_;
+  ClockDiff begin_;
+  ClockDiff elapsed_;
+  int64_t begin_events_[kNumCounterEvents];
+  CounterDiff counters_diff_;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState&);  // NOLINT
+
+// Registered benchmark with its arguments.
+class Benchmark {
+ public:
+  Benchmark(const std::string& name, BenchmarkFunction function)
+      : name_(name),
+        function_(function) {}
+
+  // Adds an argument, the benchmark is run once per argument.
+  Benchmark* Arg(int64_t arg) {
+    args_.push_back(arg);
+    return this;
+  }
+
+  // Adds the arguments lo, then max(lo, 1) * mult, max(lo, 1) * mult^2, ... up
+  // to hi. The multiplier must be at least 2.
+  Benchmark* Range(int64_t lo, int64_t hi, int64_t mult = 10) {
+    assert(mult >= 2);
+    if (lo > hi) {
+      return this;
+    }
+    args_.push_back(lo);
+    for (int64_t arg = std::max<int64_t>(lo, 1); arg <= hi / mult;) {
+      arg *= mult;
+      args_.push_back(arg);
+    }
+    return this;
+  }
+
+  const std::string& Name() const {
+    return name_;
+  }
+
+  BenchmarkFunction Function() const {
+    return function_;
+  }
+
+  const std::vector<int64_t>& Args() const {
+    return args_;
+  }
+
+ private:
+  std::string name_;
+  BenchmarkFunction function_;
+  std::vector<int64_t> args_;
+};
+
+// Returns all registered benchmarks.
+inline std::vector<Benchmark*>& Benchmarks() {
+  static std::vector<Benchmark*> benchmarks;
+  return benchmarks;
+}
+
+// Registers the given benchmark function.
+inline Benchmark* RegisterBenchmark(const std::string& name,
+                                    BenchmarkFunction function) {
+  Benchmarks().push_back(new Benchmark(name, function));
+  return Benchmarks().back();
+}
+
+// Options controlling benchmark runs.
+struct BenchmarkOptions {
+  BenchmarkOptions()
+      : min_time(ClockDiff::FromMillis(100)),
+        warmup_time(ClockDiff::FromMillis(50)),
+        repetitions(5),
+        csv(false),
+        counters(false) {}
+
+  // Parses the command line options, returns false on unknown options.
+  bool Parse(int argc, char* argv[]);
+
+  // Minimum duration of a single repetition.
+  ClockDiff min_time;
+  // Duration of the discarded warmup runs.
+  ClockDiff warmup_time;
+  int repetitions;
+  // Whether to print results as comma-separated values.
+  bool csv;
+  // Whether to count hardware events via CounterClock.
+  bool counters;
+  // Only benchmarks containing this substring are run.
+  std::string filter;
+  // CSV results of a previous run used for comparison.
+  std::string baseline;
+};
+
+// Statistics over the repetitions of a benchmark run.
+struct BenchmarkResult {
+  BenchmarkResult()
+      : iterations(0),
+        repetitions(0),
+        bytes_per_sec(0.0),
+        items_per_sec(0.0) {}
+
+  // Returns the CSV header line.
+  static std::string CsvHeader() {
+    return "name,iterations,mean_ns,median_ns,stddev_ns,bytes_per_sec,"
+           "items_per_sec,cycles,instructions,cache_misses,branch_misses";
+  }
+
+  // Returns the CSV representation.
+  std::string Csv() const {
+    std::stringstream ss;
+    ss << name << "," << iterations << "," << mean.Nanos() << ","
+       << median.Nanos() << "," << stddev.Nanos() << ","
+       << static_cast<int64_t>(bytes_per_sec) << ","
+       << static_cast<int64_t>(items_per_sec);
+    // Hardware events per iteration, fractional for cheap iterations.
+    const int64_t total = iterations * repetitions;
+    ss.setf(std::ios::fixed, std::ios::floatfield);
+    ss.precision(3);
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      ss << "," << (total > 0 ? static_cast<double>(
+          counters.Events(CounterEvent(e))) / total : 0.0);
+    }
+    return ss.str();
+  }
+
+  // Returns the string representation.
+  std::string Str() const;
+
+  std::string name;
+  // Iterations per repetition.
+  int64_t iterations;
+  int repetitions;
+  // Per-iteration durations over the repetitions.
+  ClockDiff mean;
+  ClockDiff median;
+  ClockDiff stddev;
+  double bytes_per_sec;
+  double items_per_sec;
+  // Hardware events counted over all repetitions.
+  CounterDiff counters;
+};
+
+inline std::string BenchmarkResult::Str() const {
+  std::stringstream ss;
+  ss << name << ": " << mean.Str() << " mean, " << median.Str() << " median, "
+     << stddev.Str() << " stddev (" << iterations << " iterations)";
+  if (bytes_per_sec > 0.0) {
+    ss << ", " << RateStr(bytes_per_sec, "B", true);
+  }
+  if (items_per_sec > 0.0) {
+    ss << ", " << RateStr(items_per_sec, "items", false);
+  }
+  if (counters.HasCounters()) {
+    ss << ", " << counters.EventsStr(iterations * repetitions);
+  }
+  return ss.str();
+}
+
+// Runs the given benchmark with given iterations and argument.
+inline BenchmarkState RunBenchmark(const Benchmark& benchmark,
+                                   int64_t iterations, int64_t arg,
+                                   bool counters = false) {
+  BenchmarkState state(iterations, arg, counters);
+  benchmark.Function()(state);
+  return state;
+}
+
+// Returns the number of iterations needed to run for at least the given
+// duration, calibrated by runs with exponentially growing iteration counts.
+inline int64_t CalibrateIterations(const Benchmark& benchmark, int64_t arg,
+                                   const ClockDiff& min_time) {
+  int64_t iterations = 1;
+  while (true) {
+    const ClockDiff elapsed = RunBenchmark(benchmark, iterations, arg).Elapsed();
+    if (elapsed >= min_time || iterations >= (int64_t(1) << 40)) {
+      return iterations;
+    }
+    // Aims for 1.4 times the minimum duration to avoid another calibration
+    // round, growth is bounded for unreliably short measurements.
+    const double factor = elapsed.Nanos() > 0 ?
+        1.4 * min_time.Nanos() / elapsed.Nanos() : 100.0;
+    iterations = static_cast<int64_t>(iterations *
+        std::min(100.0, std::max(2.0, factor)));
+  }
+}
+
+// Returns the name of the given benchmark run with given argument.
+inline std::string BenchmarkName(const Benchmark& benchmark, int64_t arg) {
+  if (benchmark.Args().empty()) {
+    return benchmark.Name();
+  }
+  std::stringstream ss;
+  ss << benchmark.Name() << "/" << arg;
+  return ss.str();
+}
+
+// Calibrates, warms up and runs the given benchmark with given argument.
+inline BenchmarkResult MeasureBenchmark(const Benchmark& benchmark,
+                                        int64_t arg,
+                                        const BenchmarkOptions& options) {
+  BenchmarkResult result;
+  result.name = BenchmarkName(benchmark, arg);
+  result.iterations = CalibrateIterations(benchmark, arg, options.min_time);
+  const Clock warmup_begin;
+  while (Clock() - warmup_begin < options.warmup_time) {
+    RunBenchmark(benchmark, result.iterations, arg);
+  }
+  const int repetitions = std::max(1, options.repetitions);
+  result.repetitions = repetitions;
+  std::vector<double> times;
+  double bytes = 0.0;
+  double items = 0.0;
+  double total_ns = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    const BenchmarkState state = RunBenchmark(benchmark, result.iterations,
+                                              arg, options.counters);
+    result.counters += state.Counters();
+    times.push_back(state.Elapsed().Nanos<double>() / result.iterations);
+    total_ns += state.Elapsed().Nanos<double>();
+    bytes += state.BytesProcessed();
+    items += state.ItemsProcessed();
+  }
+  double mean = 0.0;
+  for (const double t: times) {
+    mean += t;
+  }
+  mean /= times.size();
+  double variance = 0.0;
+  for (const double t: times) {
+    variance += (t - mean) * (t - mean);
+  }
+  variance /= times.size() > 1 ? times.size() - 1 : 1;
+  std::sort(times.begin(), times.end());
+  const size_t mid = times.size() / 2;
+  const double median = times.size() % 2 ? times[mid] :
+      0.5 * (times[mid - 1] + times[mid]);
+  result.mean = ClockDiff::FromNanos(std::llround(mean));
+  result.median = ClockDiff::FromNanos(std::llround(median));
+  result.stddev = ClockDiff::FromNanos(std::llround(std::sqrt(variance)));
+  if (total_ns > 0.0) {
+    result.bytes_per_sec = bytes / total_ns * ClockDiff::kNanoInSec;
+    result.items_per_sec = items / total_ns * ClockDiff::kNanoInSec;
+  }
+  return result;
+}
+
+// Reads the mean per-iteration durations from CSV results of a previous run.
+inline std::map<std::string, double> ReadBaseline(const std::string& path) {
+  std::map<std::string, double> baseline;
+  std::ifstream file(path.c_str());
+  std::string line;
+  while (std::getline(file, line)) {
+    std::stringstream ss(line);
+    std::string name;
+    std::string iterations;
+    std::string mean;
+    if (std::getline(ss, name, ',') && std::getline(ss, iterations, ',') &&
+        std::getline(ss, mean, ',') && name != "name") {
+      baseline[name] = std::atof(mean.c_str());
+    }
+  }
+  return baseline;
+}
+
+inline bool BenchmarkOptions::Parse(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq = arg.find('=');
+    const std::string key = arg.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" :
+        arg.substr(eq + 1);
+    if (key == "--filter") {
+      filter = value;
+    } else if (key == "--repetitions") {
+      repetitions = std::atoi(value.c_str());
+    } else if (key == "--min_time_ms") {
+      min_time = ClockDiff::FromMillis(std::atoll(value.c_str()));
+    } else if (key == "--warmup_ms") {
+      warmup_time = ClockDiff::FromMillis(std::atoll(value.c_str()));
+    } else if (key == "--csv") {
+      csv = true;
+    } else if (key == "--counters") {
+      counters = true;
+    } else if (key == "--baseline") {
+      baseline = value;
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--filter=<substr>]"
+                << " [--repetitions=<n>] [--min_time_ms=<ms>]"
+                << " [--warmup_ms=<ms>] [--csv] [--counters]"
+                << " [--baseline=<csv file>]"
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs all registered benchmarks matching the options and prints the results.
+// Returns the number of benchmarks run.
+inline int RunBenchmarks(const BenchmarkOptions& options,
+                         std::ostream& stream) {
+  const std::map<std::string, double> baseline = options.baseline.empty() ?
+      std::map<std::string, double>() : ReadBaseline(options.baseline);
+  if (options.counters && !CounterClock::Available()) {
+    std::cerr << "hardware counters unavailable, measuring time only"
+              << std::endl;
+  }
+  if (options.csv) {
+    stream << BenchmarkResult::CsvHeader() << std::endl;
+  }
+  int num_runs = 0;
+  for (const Benchmark* benchmark: Benchmarks()) {
+    std::vector<int64_t> args = benchmark->Args();
+    if (args.empty()) {
+      args.push_back(0);
+    }
+    for (const int64_t arg: args) {
+      if (BenchmarkName(*benchmark, arg).find(options.filter) ==
+          std::string::npos) {
+        continue;
+      }
+      const BenchmarkResult result = MeasureBenchmark(*benchmark, arg,
+                                                      options);
+      ++num_runs;
+      if (options.csv) {
+        stream << result.Csv() << std::endl;
+        continue;
+      }
+      stream << result.Str();
+      auto it = baseline.find(result.name);
+      if (it != baseline.end() && it->second > 0.0) {
+        const double change = 100.0 * (result.mean.Nanos() - it->second) /
+                              it->second;
+        stream.setf(std::ios::fixed, std::ios::floatfield);
+        stream.precision(1);
+        stream << " [" << (change >= 0.0 ? "+" : "") << change
+               << "% vs baseline]";
+      }
+      stream << std::endl;
+    }
+  }
+  return num_runs;
+}
+
+}  // namespace time
+}  // namespace flow
+
+// Registers the given benchmark function, arguments may be appended:
+//   FLOW_BENCHMARK(BM_Foo)->Arg(10)->Arg(1000);
+#define FLOW_BENCHMARK(function) \
+  static ::flow::time::Benchmark* FLOW_CONCAT(flow_benchmark_, \
+      __LINE__) = ::flow::time::RegisterBenchmark(#function, function)
+
+// Defines the main function running all registered benchmarks.
+#define FLOW_BENCHMARK_MAIN() \
+  int main(int argc, char* argv[]) { \
+    ::flow::time::BenchmarkOptions options; \
+    if (!options.Parse(argc, argv)) { \
+      return 1; \
+    } \
+    ::flow::time::RunBenchmarks(options, std::cout); \
+    return 0; \
+  }
+
+#endif  // SRC_TIME_BENCHMARK_H_
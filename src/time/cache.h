@@ -0,0 +1,15 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_CACHE_H_
+#define SRC_TIME_CACHE_H_
+
+#include <cstddef>
+
+namespace flow {
+namespace time {
+
+// Assumed cache line size, used to pad concurrently written members.
+static const size_t kCacheLineSize = 64;
+
+}  // namespace time
+}  // namespace flow
+#endif  // SRC_TIME_CACHE_H_
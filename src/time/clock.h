@@ -2,6 +2,7 @@
 #ifndef SRC_TIME_CLOCK_H_
 #define SRC_TIME_CLOCK_H_
 
+#include <chrono>
 #include <cstdint>
 #include <ctime>
 #include <string>
@@ -10,7 +11,7 @@
 namespace flow {
 namespace time {
 
-// Type for time differences.
+// Type for time differences, stored with nanosecond resolution.
 class ClockDiff {
  public:
   typedef int64_t ValueType;
@@ -24,6 +25,12 @@ class ClockDiff {
       kMicroInMilli;
   static const typename ClockDiff::ValueType kMicroInMin = kMicroInSec *
       kSecInMin;
+  static const typename ClockDiff::ValueType kNanoInMilli = kNanoInMicro *
+      kMicroInMilli;
+  static const typename ClockDiff::ValueType kNanoInSec = kNanoInMilli *
+      kMilliInSec;
+  static const typename ClockDiff::ValueType kNanoInMin = kNanoInSec *
+      kSecInMin;
   static constexpr double kMilliInMicro = 1.0 / kMicroInMilli;
   static constexpr double kMicroInNano = 1.0 / kNanoInMicro;
   static constexpr double kSecInMicro = 1.0 / kMicroInSec;
@@ -33,9 +40,37 @@ class ClockDiff {
   ClockDiff()  // NOLINT
       : value_() {}
 
-  // Implicit constructor.
+  // Implicit constructor, the value is given in microseconds.
   ClockDiff(const ValueType& value)  // NOLINT
-      : value_(value) {}
+      : value_(value * kNanoInMicro) {}
+
+  // Implicit constructor for std::chrono durations.
+  template<typename Rep, typename Period>
+  ClockDiff(const std::chrono::duration<Rep, Period>& duration)  // NOLINT
+      : value_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            duration).count()) {}
+
+  // Returns a diff of the given number of nanoseconds.
+  static ClockDiff FromNanos(const ValueType& value) {
+    ClockDiff diff;
+    diff.value_ = value;
+    return diff;
+  }
+
+  // Returns a diff of the given number of microseconds.
+  static ClockDiff FromMicros(const ValueType& value) {
+    return FromNanos(value * kNanoInMicro);
+  }
+
+  // Returns a diff of the given number of milliseconds.
+  static ClockDiff FromMillis(const ValueType& value) {
+    return FromNanos(value * kNanoInMilli);
+  }
+
+  // Returns a diff of the given number of seconds.
+  static ClockDiff FromSecs(const ValueType& value) {
+    return FromNanos(value * kNanoInSec);
+  }
 
   // Self-assignment addition.
   ClockDiff& operator+=(const ClockDiff& rhs) {
@@ -51,47 +86,103 @@ class ClockDiff {
 
   // Addition.
   ClockDiff operator+(const ClockDiff& rhs) const {
-    return ClockDiff(value_ + rhs.value_);
+    return FromNanos(value_ + rhs.value_);
   }
 
   // Subtraction.
   ClockDiff operator-(const ClockDiff& rhs) const {
-    return ClockDiff(value_ - rhs.value_);
+    return FromNanos(value_ - rhs.value_);
   }
 
-  // Division.
+  // Division, both operands are treated as microsecond values.
   ClockDiff operator/(const ClockDiff& rhs) const {
-    return ClockDiff(value_ / rhs.value_);
+    return FromNanos(value_ * kNanoInMicro / rhs.value_);
   }
 
-  // Multiplication.
+  // Multiplication, both operands are treated as microsecond values. The
+  // product is computed with 128 bits to avoid overflows.
   ClockDiff operator*(const ClockDiff& rhs) const {
-    return ClockDiff(value_ * rhs.value_);
+    return FromNanos(static_cast<ValueType>(
+        static_cast<__int128>(value_) * rhs.value_ / kNanoInMicro));
+  }
+
+  // Scalar division.
+  ClockDiff operator/(const ValueType& rhs) const {
+    return FromNanos(value_ / rhs);
   }
 
+  // Scalar multiplication.
+  ClockDiff operator*(const ValueType& rhs) const {
+    return FromNanos(value_ * rhs);
+  }
+
+  // Comparison operators.
+  bool operator==(const ClockDiff& rhs) const { return value_ == rhs.value_; }
+  bool operator!=(const ClockDiff& rhs) const { return value_ != rhs.value_; }
+  bool operator<(const ClockDiff& rhs) const { return value_ < rhs.value_; }
+  bool operator<=(const ClockDiff& rhs) const { return value_ <= rhs.value_; }
+  bool operator>(const ClockDiff& rhs) const { return value_ > rhs.value_; }
+  bool operator>=(const ClockDiff& rhs) const { return value_ >= rhs.value_; }
+
   // Returns the string representation.
   std::string Str() const {
     std::stringstream ss;
     ss.setf(std::ios::fixed, std::ios::floatfield);
     ss.precision(2);
-    if (value_ >= kMicroInMin) {
-      const double min = value_ * kMinInMicro;
-      ss << min << "min";
-    } else if (value_ >= kMicroInSec) {
-      const double sec = value_ * kSecInMicro;
-      ss << sec << "s";
-    } else if (value_ >= kMicroInMilli) {
-      const double milli = value_ * kMilliInMicro;
-      ss << milli << "ms";
+    if (value_ >= kNanoInMin) {
+      ss << Mins<double>() << "min";
+    } else if (value_ >= kNanoInSec) {
+      ss << Secs<double>() << "s";
+    } else if (value_ >= kNanoInMilli) {
+      ss << Millis<double>() << "ms";
+    } else if (value_ >= kNanoInMicro) {
+      ss << Micros<double>() << "µs";
     } else {
-      ss << value_ << "µs";
+      ss << value_ << "ns";
     }
     return ss.str();
   }
 
+  // Returns the diff in nanoseconds.
+  template<typename T = ValueType>
+  T Nanos() const {
+    return static_cast<T>(value_);
+  }
+
+  // Returns the diff in microseconds, integral types are truncated.
+  template<typename T = ValueType>
+  T Micros() const {
+    return static_cast<T>(value_) / static_cast<T>(kNanoInMicro);
+  }
+
+  // Returns the diff in milliseconds, integral types are truncated.
+  template<typename T = ValueType>
+  T Millis() const {
+    return static_cast<T>(value_) / static_cast<T>(kNanoInMilli);
+  }
+
+  // Returns the diff in seconds, integral types are truncated.
+  template<typename T = ValueType>
+  T Secs() const {
+    return static_cast<T>(value_) / static_cast<T>(kNanoInSec);
+  }
+
+  // Returns the diff in minutes, integral types are truncated.
+  template<typename T = ValueType>
+  T Mins() const {
+    return static_cast<T>(value_) / static_cast<T>(kNanoInMin);
+  }
+
+  // Returns the diff as std::chrono duration, truncated to its period.
+  template<typename Duration = std::chrono::nanoseconds>
+  Duration ToDuration() const {
+    return std::chrono::duration_cast<Duration>(
+        std::chrono::nanoseconds(value_));
+  }
+
   // Returns the integral value of the diff (microseconds).
-  const ValueType& Value() const {
-    return value_;
+  ValueType Value() const {
+    return Micros();
   }
 
  private:
@@ -116,21 +207,27 @@ class BasicClock {
     clock_gettime(_ClockType, &time_);
   }
 
-  // Returns the time difference in microseconds between this and the given
-  // clock's time.
+  // Returns the time difference between this and the given clock's time.
   Diff operator-(const BasicClock& rhs) const {
-    return Diff((time_.tv_sec - rhs.time_.tv_sec) * Diff::kMicroInSec +
-                (time_.tv_nsec - rhs.time_.tv_nsec) * Diff::kMicroInNano);
+    return Diff::FromNanos((time_.tv_sec - rhs.time_.tv_sec) *
+                           Diff::kNanoInSec +
+                           (time_.tv_nsec - rhs.time_.tv_nsec));
+  }
+
+  // Returns the current clock time as diff to the clock's (unspecified) epoch.
+  static Diff Now() {
+    timespec time;
+    clock_gettime(_ClockType, &time);
+    return Diff::FromNanos(time.tv_sec * Diff::kNanoInSec + time.tv_nsec);
   }
 
   // Returns the system time resolution.
-  // Remark: Usually returns 0µs (1ns), this is however a bad promise and does
-  // not reflect the (dynamic) underlying clock event resolution.
+  // Remark: Usually returns 1ns, this is however a bad promise and does not
+  // reflect the (dynamic) underlying clock event resolution.
   static Diff Resolution(Type type) {
     timespec res;
     clock_getres(type, &res);
-    return Diff(res.tv_sec * Diff::kMicroInSec + res.tv_nsec *
-                Diff::kMicroInNano);
+    return Diff::FromNanos(res.tv_sec * Diff::kNanoInSec + res.tv_nsec);
   }
 
  private:
@@ -141,6 +238,25 @@ typedef BasicClock<> Clock;
 typedef BasicClock<CLOCK_PROCESS_CPUTIME_ID> ProcessClock;
 typedef BasicClock<CLOCK_THREAD_CPUTIME_ID> ThreadClock;
 
+// Returns the pretty-printed rate per second with binary or decimal unit
+// prefixes, e.g. "1.50 kB/s".
+inline std::string RateStr(double rate, const std::string& unit,
+                           bool binary = false) {
+  static const char* kPrefixes[] = {"", "k", "M", "G", "T"};
+  const double base = binary ? 1024.0 : 1000.0;
+  int prefix = 0;
+  while (rate >= base && prefix < 4) {
+    rate /= base;
+    ++prefix;
+  }
+  std::stringstream ss;
+  ss.setf(std::ios::fixed, std::ios::floatfield);
+  ss.precision(2);
+  ss << rate << " " << (binary && prefix ? std::string(kPrefixes[prefix]) + "i" :
+                 std::string(kPrefixes[prefix])) << unit << "/s";
+  return ss.str();
+}
+
 // Stream output operator overload for Diff.
 inline std::ostream& operator<<(std::ostream& stream, const ClockDiff& diff) {
   return stream << diff.Str();
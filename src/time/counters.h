@@ -0,0 +1,296 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_COUNTERS_H_
+#define SRC_TIME_COUNTERS_H_
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include "./clock.h"
+
+namespace flow {
+namespace time {
+
+// Hardware events counted by the CounterClock.
+enum CounterEvent {
+  kCycles = 0,
+  kInstructions = 1,
+  kCacheMisses = 2,
+  kBranchMisses = 3,
+  kNumCounterEvents = 4,
+};
+
+// Group of hardware performance counters for the calling thread, opened via
+// perf_event_open. The counters are grouped with the cycles counter as leader
+// and are therefore read atomically. When the leader can not be opened (e.g.
+// missing permissions, virtualized or containerized environments) the group is
+// unavailable. Events not supported by the PMU are omitted individually.
+class CounterGroup {
+ public:
+  CounterGroup()
+      : leader_(-1),
+        num_open_(0) {
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      fds_[e] = -1;
+      slots_[e] = -1;
+    }
+#ifdef __linux__
+    static const uint64_t kConfigs[kNumCounterEvents] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = kConfigs[e];
+      attr.disabled = e == kCycles;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader_, 0);
+      if (fd == -1) {
+        if (e == kCycles) {
+          return;
+        }
+        continue;
+      }
+      if (e == kCycles) {
+        leader_ = fd;
+      }
+      fds_[e] = fd;
+      slots_[e] = num_open_++;
+    }
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  ~CounterGroup() {
+#ifdef __linux__
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      if (fds_[e] != -1) {
+        close(fds_[e]);
+      }
+    }
+#endif
+  }
+
+  // Returns the counter group of the calling thread.
+  static CounterGroup& Local() {
+    static thread_local CounterGroup group;
+    return group;
+  }
+
+  // Returns whether the counters are available.
+  bool Available() const {
+    return leader_ != -1;
+  }
+
+  // Returns whether the given event is counted.
+  bool Available(CounterEvent event) const {
+    return fds_[event] != -1;
+  }
+
+  // Reads the current counter values, scaled for multiplexing. Unavailable
+  // events are set to 0. Returns false if the counters are unavailable.
+  bool Read(int64_t values[kNumCounterEvents]) const {
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      values[e] = 0;
+    }
+    if (!Available()) {
+      return false;
+    }
+#ifdef __linux__
+    // Layout: nr, time_enabled, time_running, value[nr].
+    uint64_t data[3 + kNumCounterEvents];
+    const ssize_t size = (3 + num_open_) * sizeof(uint64_t);
+    if (read(leader_, data, size) != size) {
+      return false;
+    }
+    const double scale = data[2] > 0 && data[2] < data[1] ?
+        static_cast<double>(data[1]) / data[2] : 1.0;
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      if (slots_[e] != -1) {
+        values[e] = static_cast<int64_t>(data[3 + slots_[e]] * scale);
+      }
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  CounterGroup(const CounterGroup&);
+  CounterGroup& operator=(const CounterGroup&);
+
+  int leader_;
+  int num_open_;
+  int fds_[kNumCounterEvents];
+  // Position of the events within the group read.
+  int slots_[kNumCounterEvents];
+};
+
+// Difference of two counter clock readings: the elapsed wall-clock time and
+// the hardware events counted in between.
+class CounterDiff {
+ public:
+  // Default constructor.
+  CounterDiff()  // NOLINT
+      : has_counters_(false) {
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      events_[e] = 0;
+    }
+  }
+
+  CounterDiff(const ClockDiff& time, const int64_t* events, bool has_counters)
+      : time_(time),
+        has_counters_(has_counters) {
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      events_[e] = events[e];
+    }
+  }
+
+  // Self-assignment addition.
+  CounterDiff& operator+=(const CounterDiff& rhs) {
+    time_ += rhs.time_;
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      events_[e] += rhs.events_[e];
+    }
+    has_counters_ = has_counters_ || rhs.has_counters_;
+    return *this;
+  }
+
+  // Addition.
+  CounterDiff operator+(const CounterDiff& rhs) const {
+    CounterDiff diff = *this;
+    return diff += rhs;
+  }
+
+  // Returns the elapsed time.
+  const ClockDiff& Time() const {
+    return time_;
+  }
+
+  // Returns the number of counted events of given type.
+  int64_t Events(CounterEvent event) const {
+    return events_[event];
+  }
+
+  // Returns whether hardware events have been counted.
+  bool HasCounters() const {
+    return has_counters_;
+  }
+
+  // Returns the instructions per cycle.
+  double Ipc() const {
+    return events_[kCycles] > 0 ?
+        static_cast<double>(events_[kInstructions]) / events_[kCycles] : 0.0;
+  }
+
+  // Returns the string representation, with time and event counts per item if
+  // items is greater than 1. Falls back to the time only if counters are
+  // unavailable.
+  std::string Str(int64_t items = 1) const {
+    items = items < 1 ? 1 : items;
+    std::string str = (time_ / items).Str() + (items > 1 ? "/item" : "");
+    if (has_counters_) {
+      str += " " + EventsStr(items);
+    }
+    return str;
+  }
+
+  // Returns the string representation of the IPC and the event counts per item
+  // if items is greater than 1.
+  std::string EventsStr(int64_t items = 1) const {
+    static const char* kNames[kNumCounterEvents] = {
+      "cycles", "instructions", "cache-misses", "branch-misses"
+    };
+    items = items < 1 ? 1 : items;
+    const std::string per_item = items > 1 ? "/item" : "";
+    std::stringstream ss;
+    ss.setf(std::ios::fixed, std::ios::floatfield);
+    ss.precision(2);
+    ss << Ipc() << " IPC";
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      ss << " " << CountStr(static_cast<double>(events_[e]) / items) << " "
+         << kNames[e] << per_item;
+    }
+    return ss.str();
+  }
+
+ private:
+  // Returns the count pretty-printed with decimal unit prefixes.
+  static std::string CountStr(double count) {
+    static const char* kPrefixes[] = {"", "k", "M", "G", "T"};
+    int prefix = 0;
+    while (count >= 1000.0 && prefix < 4) {
+      count /= 1000.0;
+      ++prefix;
+    }
+    std::stringstream ss;
+    ss.setf(std::ios::fixed, std::ios::floatfield);
+    ss.precision(prefix || count != static_cast<int64_t>(count) ? 2 : 0);
+    ss << count << kPrefixes[prefix];
+    return ss.str();
+  }
+
+  ClockDiff time_;
+  int64_t events_[kNumCounterEvents];
+  bool has_counters_;
+};
+
+// Clock capturing the wall-clock time and the calling thread's hardware
+// performance counters. Differences of readings taken on the same thread yield
+// the events counted in between. Degrades to wall-clock time only if the
+// counters are unavailable.
+class CounterClock {
+ public:
+  typedef CounterDiff Diff;
+
+  // Initializes the clock with the current time and counter values.
+  CounterClock()
+      : has_counters_(CounterGroup::Local().Read(events_)),
+        time_(Clock::Now()) {}
+
+  // Returns the difference between this and the given clock's reading.
+  Diff operator-(const CounterClock& rhs) const {
+    int64_t events[kNumCounterEvents];
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      events[e] = events_[e] - rhs.events_[e];
+    }
+    return Diff(time_ - rhs.time_, events,
+                has_counters_ && rhs.has_counters_);
+  }
+
+  // Returns whether hardware counters are available for the calling thread.
+  static bool Available() {
+    return CounterGroup::Local().Available();
+  }
+
+ private:
+  int64_t events_[kNumCounterEvents];
+  bool has_counters_;
+  ClockDiff time_;
+};
+
+// Stream output operator overload for CounterDiff.
+inline std::ostream& operator<<(std::ostream& stream, const CounterDiff& diff) {
+  return stream << diff.Str();
+}
+
+}  // namespace time
+}  // namespace flow
+#endif  // SRC_TIME_COUNTERS_H_
@@ -0,0 +1,426 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_HISTOGRAM_H_
+#define SRC_TIME_HISTOGRAM_H_
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./clock.h"
+#include "../io/serialize.h"
+
+namespace flow {
+namespace time {
+
+// Log-linear bucket layout for nanosecond values in [0, max]. Values below
+// 2^bits are counted exactly, larger values share buckets with a relative
+// width of at most 2^(1 - bits).
+class HistogramLayout {
+ public:
+  // Highest supported number of bits, as needed for 5 significant digits.
+  static const int kMaxBits = 18;
+
+  // Default constructor, creates an empty layout.
+  HistogramLayout()
+      : bits_(1),
+        max_(0),
+        size_(0) {}
+
+  // Initializes the layout for values up to the given max with given number of
+  // significant decimal digits.
+  HistogramLayout(const ClockDiff& max, int significant_digits)
+      : bits_(BitsForDigits(significant_digits)),
+        max_(max.Nanos() > 0 ? max.Nanos() : 1),
+        size_(Index(max_) + 1) {}
+
+  // Returns the layout for values up to the given max with given number of
+  // bits per sub-bucket range.
+  static HistogramLayout FromBits(int bits, const ClockDiff& max) {
+    HistogramLayout layout;
+    layout.bits_ = bits > 1 ? (bits < kMaxBits ? bits : kMaxBits) : 1;
+    layout.max_ = max.Nanos() > 0 ? max.Nanos() : 1;
+    layout.size_ = layout.Index(layout.max_) + 1;
+    return layout;
+  }
+
+  // Returns the number of bits needed to distinguish the given number of
+  // significant decimal digits.
+  static int BitsForDigits(int significant_digits) {
+    assert(significant_digits >= 1 && significant_digits <= 5 &&
+           "Unsupported number of significant digits.");
+    const double sub_buckets = 2.0 * std::pow(10.0, significant_digits);
+    return static_cast<int>(std::ceil(std::log2(sub_buckets)));
+  }
+
+  // Returns the bucket index for the given value, values are clamped to the
+  // layout range.
+  size_t Index(int64_t value) const {
+    if (value < 0) {
+      value = 0;
+    } else if (value > max_) {
+      value = max_;
+    }
+    const int shift = Shift(value);
+    return (static_cast<size_t>(shift) << (bits_ - 1)) +
+           static_cast<size_t>(value >> shift);
+  }
+
+  // Returns the lowest value counted by the bucket with given index.
+  int64_t Lowest(size_t index) const {
+    const int64_t half = int64_t(1) << (bits_ - 1);
+    if (static_cast<int64_t>(index) < 2 * half) {
+      return index;
+    }
+    const int shift = static_cast<int>(index >> (bits_ - 1)) - 1;
+    const int64_t sub = static_cast<int64_t>(index) - shift * half;
+    return sub << shift;
+  }
+
+  // Returns the highest value counted by the bucket with given index.
+  int64_t Highest(size_t index) const {
+    return Lowest(index + 1) - 1;
+  }
+
+  // Returns the number of buckets.
+  size_t Size() const {
+    return size_;
+  }
+
+  // Returns the number of bits per sub-bucket range.
+  int Bits() const {
+    return bits_;
+  }
+
+  // Returns the highest trackable value in nanoseconds.
+  int64_t Max() const {
+    return max_;
+  }
+
+  bool operator==(const HistogramLayout& rhs) const {
+    return bits_ == rhs.bits_ && max_ == rhs.max_;
+  }
+
+  bool operator!=(const HistogramLayout& rhs) const {
+    return !(*this == rhs);
+  }
+
+ private:
+  // Returns the right shift used to map the value to its sub-bucket.
+  int Shift(int64_t value) const {
+    if (value == 0) {
+      return 0;
+    }
+    const int msb = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    return msb < bits_ ? 0 : msb - bits_ + 1;
+  }
+
+  int bits_;
+  int64_t max_;
+  size_t size_;
+};
+
+// Non-atomic copy of histogram counts, used for queries, merging and
+// serialization.
+class HistogramSnapshot {
+ public:
+  // Default constructor, creates an empty snapshot without buckets.
+  HistogramSnapshot()
+      : count_(0),
+        sum_(0),
+        min_(0),
+        max_(0) {}
+
+  // Initializes an empty snapshot with given layout.
+  explicit HistogramSnapshot(const HistogramLayout& layout)
+      : layout_(layout),
+        counts_(layout.Size(), 0),
+        count_(0),
+        sum_(0),
+        min_(0),
+        max_(0) {}
+
+  // Initializes the snapshot with given layout, bucket counts and extremes.
+  HistogramSnapshot(const HistogramLayout& layout,
+                    const std::vector<uint64_t>& counts, uint64_t count,
+                    const ClockDiff& sum, const ClockDiff& min,
+                    const ClockDiff& max)
+      : layout_(layout),
+        counts_(counts),
+        count_(count),
+        sum_(sum.Nanos()),
+        min_(min.Nanos()),
+        max_(max.Nanos()) {
+    counts_.resize(layout.Size(), 0);
+  }
+
+  // Adds the counts of the given snapshot. Returns false and leaves this
+  // snapshot unchanged if the layouts differ.
+  bool Merge(const HistogramSnapshot& other) {
+    if (count_ == 0 && counts_.empty()) {
+      *this = other;
+      return true;
+    }
+    if (layout_ != other.layout_ || counts_.size() != other.counts_.size()) {
+      return false;
+    }
+    if (other.count_ == 0) {
+      return true;
+    }
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    min_ = count_ == 0 || other.min_ < min_ ? other.min_ : min_;
+    max_ = count_ == 0 || other.max_ > max_ ? other.max_ : max_;
+    count_ += other.count_;
+    sum_ += other.sum_;
+    return true;
+  }
+
+  // Returns the value at the given percentile in [0, 100]. The result is the
+  // highest value equivalent to the matching bucket, bounded by the recorded
+  // extremes.
+  ClockDiff Percentile(double percentile) const {
+    if (count_ == 0) {
+      return ClockDiff();
+    }
+    if (percentile <= 0.0) {
+      return Min();
+    }
+    uint64_t target = static_cast<uint64_t>(
+        std::ceil(percentile / 100.0 * count_));
+    target = target == 0 ? 1 : (target > count_ ? count_ : target);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        int64_t value = layout_.Highest(i);
+        value = value > max_ ? max_ : (value < min_ ? min_ : value);
+        return ClockDiff::FromNanos(value);
+      }
+    }
+    return Max();
+  }
+
+  // Returns the arithmetic mean of the recorded values.
+  ClockDiff Mean() const {
+    return count_ == 0 ? ClockDiff() :
+        ClockDiff::FromNanos(sum_ / static_cast<int64_t>(count_));
+  }
+
+  // Returns the smallest recorded value.
+  ClockDiff Min() const {
+    return ClockDiff::FromNanos(min_);
+  }
+
+  // Returns the largest recorded value (clamped to the layout range).
+  ClockDiff Max() const {
+    return ClockDiff::FromNanos(max_);
+  }
+
+  // Returns the number of recorded values.
+  uint64_t Count() const {
+    return count_;
+  }
+
+  // Returns the sum of the recorded values.
+  ClockDiff Sum() const {
+    return ClockDiff::FromNanos(sum_);
+  }
+
+  // Returns the string representation.
+  std::string Str() const {
+    std::stringstream ss;
+    ss << "count " << count_
+       << " mean " << Mean().Str()
+       << " min " << Min().Str()
+       << " p50 " << Percentile(50.0).Str()
+       << " p90 " << Percentile(90.0).Str()
+       << " p99 " << Percentile(99.0).Str()
+       << " p99.9 " << Percentile(99.9).Str()
+       << " max " << Max().Str();
+    return ss.str();
+  }
+
+  const HistogramLayout& Layout() const {
+    return layout_;
+  }
+
+  const std::vector<uint64_t>& Counts() const {
+    return counts_;
+  }
+
+ private:
+  friend class Histogram;
+
+  HistogramLayout layout_;
+  std::vector<uint64_t> counts_;
+  uint64_t count_;
+  int64_t sum_;
+  int64_t min_;
+  int64_t max_;
+};
+
+// Fixed-memory latency histogram for ClockDiff samples. Recording is O(1) and
+// lock-free, any number of threads may record concurrently.
+class Histogram {
+ public:
+  // Initializes the histogram for values up to max with given number of
+  // significant decimal digits. Larger values are clamped to max.
+  explicit Histogram(const ClockDiff& max = ClockDiff::FromSecs(3600),
+                     int significant_digits = 2)
+      : layout_(max, significant_digits),
+        counts_(new std::atomic<uint64_t>[layout_.Size()]) {
+    Reset();
+  }
+
+  // Records the given value.
+  void Record(const ClockDiff& value) {
+    int64_t v = value.Nanos();
+    v = v < 0 ? 0 : (v > layout_.Max() ? layout_.Max() : v);
+    counts_[layout_.Index(v)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(v, std::memory_order_relaxed);
+    int64_t min = min_.load(std::memory_order_relaxed);
+    while (v < min && !min_.compare_exchange_weak(min, v,
+        std::memory_order_relaxed)) {}
+    int64_t max = max_.load(std::memory_order_relaxed);
+    while (v > max && !max_.compare_exchange_weak(max, v,
+        std::memory_order_relaxed)) {}
+  }
+
+  // Returns a copy of the current counts. Concurrent recordings may be
+  // partially included.
+  HistogramSnapshot Snapshot() const {
+    HistogramSnapshot snapshot(layout_);
+    for (size_t i = 0; i < layout_.Size(); ++i) {
+      snapshot.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count_ = count_.load(std::memory_order_relaxed);
+    snapshot.sum_ = sum_.load(std::memory_order_relaxed);
+    if (snapshot.count_ > 0) {
+      snapshot.min_ = min_.load(std::memory_order_relaxed);
+      snapshot.max_ = max_.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+  }
+
+  // Resets all counts, must not be called concurrently to recordings.
+  void Reset() {
+    for (size_t i = 0; i < layout_.Size(); ++i) {
+      counts_[i].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  const HistogramLayout& Layout() const {
+    return layout_;
+  }
+
+  // Returns the string representation of a snapshot.
+  std::string Str() const {
+    return Snapshot().Str();
+  }
+
+ private:
+  Histogram(const Histogram&);
+  Histogram& operator=(const Histogram&);
+
+  const HistogramLayout layout_;
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<uint64_t> count_;
+  std::atomic<int64_t> sum_;
+  std::atomic<int64_t> min_;
+  std::atomic<int64_t> max_;
+};
+
+// Stream output operator overload for HistogramSnapshot.
+inline std::ostream& operator<<(std::ostream& stream,
+                                const HistogramSnapshot& snapshot) {
+  return stream << snapshot.Str();
+}
+
+// Stream output operator overload for Histogram.
+inline std::ostream& operator<<(std::ostream& stream,
+                                const Histogram& histogram) {
+  return stream << histogram.Str();
+}
+
+// Writes the given histogram snapshot to the stream, only non-empty buckets
+// are stored. Declared in the snapshot's namespace, so that the container
+// overloads of flow::io::Write find it via argument-dependent lookup.
+inline void Write(const HistogramSnapshot& target,  // NOLINT
+                  std::ostream& stream) {
+  const int32_t bits = target.Layout().Bits();
+  flow::io::Write(bits, stream);
+  flow::io::Write(target.Layout().Max(), stream);
+  flow::io::Write(target.Count(), stream);
+  flow::io::Write(target.Sum(), stream);
+  flow::io::Write(target.Min(), stream);
+  flow::io::Write(target.Max(), stream);
+  std::vector<std::pair<uint64_t, uint64_t> > buckets;
+  const std::vector<uint64_t>& counts = target.Counts();
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i]) {
+      buckets.push_back(std::make_pair(i, counts[i]));
+    }
+  }
+  flow::io::Write(buckets, stream);
+}
+
+// Reads a histogram snapshot from the stream and writes it to the given target.
+// Sets the stream's failbit and leaves the target empty if the stored layout
+// is invalid.
+inline void Read(std::istream& stream,  // NOLINT
+                 HistogramSnapshot* target) {
+  int32_t bits = 0;
+  int64_t layout_max = 0;
+  flow::io::Read(stream, &bits);
+  flow::io::Read(stream, &layout_max);
+  if (!stream || bits < 1 || bits > HistogramLayout::kMaxBits ||
+      layout_max < 1) {
+    stream.setstate(std::ios::failbit);
+    *target = HistogramSnapshot();
+    return;
+  }
+  uint64_t count;
+  ClockDiff sum;
+  ClockDiff min;
+  ClockDiff max;
+  std::vector<std::pair<uint64_t, uint64_t> > buckets;
+  flow::io::Read(stream, &count);
+  flow::io::Read(stream, &sum);
+  flow::io::Read(stream, &min);
+  flow::io::Read(stream, &max);
+  flow::io::Read(stream, &buckets);
+  const HistogramLayout layout =
+      HistogramLayout::FromBits(bits, ClockDiff::FromNanos(layout_max));
+  std::vector<uint64_t> counts(layout.Size(), 0);
+  for (const auto& bucket: buckets) {
+    if (bucket.first < counts.size()) {
+      counts[bucket.first] = bucket.second;
+    }
+  }
+  *target = HistogramSnapshot(layout, counts, count, sum, min, max);
+}
+
+}  // namespace time
+
+namespace io {
+
+using flow::time::Read;
+using flow::time::Write;
+
+}  // namespace io
+}  // namespace flow
+#endif  // SRC_TIME_HISTOGRAM_H_
@@ -0,0 +1,10 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_MACROS_H_
+#define SRC_TIME_MACROS_H_
+
+// Concatenates the given tokens after expanding them, used to create unique
+// variable names via __LINE__.
+#define FLOW_CONCAT_(a, b) a ## b
+#define FLOW_CONCAT(a, b) FLOW_CONCAT_(a, b)
+
+#endif  // SRC_TIME_MACROS_H_
@@ -0,0 +1,236 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_METER_H_
+#define SRC_TIME_METER_H_
+
+#include <stdlib.h>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "./cache.h"
+#include "./clock.h"
+
+namespace flow {
+namespace time {
+
+// Rates of a meter at the time of a snapshot, in events per second.
+struct MeterSnapshot {
+  MeterSnapshot()
+      : count(0),
+        mean(0.0),
+        instant(0.0),
+        window(0.0),
+        m1(0.0),
+        m5(0.0),
+        m15(0.0) {}
+
+  // Returns the string representation.
+  std::string Str() const {
+    std::stringstream ss;
+    ss << count << " " << unit << ", " << RateStr(instant, unit)
+       << " (mean " << RateStr(mean, unit)
+       << ", window " << RateStr(window, unit)
+       << ", 1m " << RateStr(m1, unit)
+       << ", 5m " << RateStr(m5, unit)
+       << ", 15m " << RateStr(m15, unit) << ")";
+    return ss.str();
+  }
+
+  std::string unit;
+  // Total number of events.
+  int64_t count;
+  // Rate since the creation of the meter.
+  double mean;
+  // Rate within the last completed tick.
+  double instant;
+  // Rate within the sliding window.
+  double window;
+  // Exponentially weighted moving average rates over 1, 5 and 15 minutes.
+  double m1;
+  double m5;
+  double m15;
+};
+
+// Stream output operator overload for MeterSnapshot.
+inline std::ostream& operator<<(std::ostream& stream,
+                                const MeterSnapshot& snapshot) {
+  return stream << snapshot.Str();
+}
+
+// Throughput meter measuring event rates. Events are counted in sharded,
+// cache-line-padded counters, so that concurrent writers do not contend. The
+// rates are updated in ticks of one second when snapshots are taken, ticks
+// missed in between are caught up by spreading their events evenly.
+class Meter {
+ public:
+  static const int kNumShards = 64;
+  static const int kWindowTicks = 60;
+
+  // Initializes the meter for events of given unit, started at given time (as
+  // returned by Clock::Now).
+  explicit Meter(const std::string& unit = "ops",
+                 const ClockDiff& start = Clock::Now())
+      : shards_(NewShards()),
+        unit_(unit),
+        start_(start),
+        last_tick_(start),
+        last_count_(0),
+        instant_(0.0),
+        window_(kWindowTicks, 0.0),
+        window_pos_(0),
+        window_ticks_(0) {
+    for (int s = 0; s < kNumShards; ++s) {
+      shards_[s].value.store(0, std::memory_order_relaxed);
+    }
+    for (int m = 0; m < kNumAverages; ++m) {
+      averages_[m] = 0.0;
+    }
+  }
+
+  // Records the given number of events.
+  void Mark(int64_t n = 1) {
+    shards_[ShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  // Returns the total number of events.
+  int64_t Count() const {
+    int64_t count = 0;
+    for (int s = 0; s < kNumShards; ++s) {
+      count += shards_[s].value.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  // Returns the current rates.
+  MeterSnapshot Snapshot() {
+    return Snapshot(Clock::Now());
+  }
+
+  // Returns the rates at the given time (as returned by Clock::Now).
+  MeterSnapshot Snapshot(const ClockDiff& now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Tick(now);
+    MeterSnapshot snapshot;
+    snapshot.unit = unit_;
+    snapshot.count = Count();
+    const double elapsed = (now - start_).Secs<double>();
+    snapshot.mean = elapsed > 0.0 ? snapshot.count / elapsed : 0.0;
+    snapshot.instant = instant_;
+    if (window_ticks_ > 0) {
+      double sum = 0.0;
+      for (int t = 0; t < kWindowTicks; ++t) {
+        sum += window_[t];
+      }
+      snapshot.window = sum / (window_ticks_ * TickInterval().Secs<double>());
+    }
+    snapshot.m1 = averages_[0];
+    snapshot.m5 = averages_[1];
+    snapshot.m15 = averages_[2];
+    return snapshot;
+  }
+
+  // Returns the string representation of the current rates.
+  std::string Str() {
+    return Snapshot().Str();
+  }
+
+  // Returns the interval in which the rates are updated.
+  static ClockDiff TickInterval() {
+    return ClockDiff::FromSecs(1);
+  }
+
+ private:
+  static const int kNumAverages = 3;
+
+  // Event counter padded to a full cache line.
+  struct Shard {
+    std::atomic<int64_t> value;
+    char padding[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+  };
+
+  // Releases shards allocated by NewShards.
+  struct ShardsDeleter {
+    void operator()(Shard* shards) const {
+      free(shards);
+    }
+  };
+
+  // Returns the shards allocated at a cache line boundary, so that no shard
+  // straddles two cache lines wherever the meter itself is placed.
+  static Shard* NewShards() {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, kCacheLineSize, kNumShards * sizeof(Shard)) != 0) {
+      throw std::bad_alloc();
+    }
+    Shard* shards = static_cast<Shard*>(ptr);
+    for (int s = 0; s < kNumShards; ++s) {
+      new (&shards[s]) Shard;
+    }
+    return shards;
+  }
+
+  Meter(const Meter&);
+  Meter& operator=(const Meter&);
+
+  // Returns the shard of the calling thread, threads are assigned to shards in
+  // round-robin order.
+  static int ShardIndex() {
+    static std::atomic<int> next_shard(0);
+    static thread_local int shard = -1;
+    if (shard == -1) {
+      shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+    }
+    return shard;
+  }
+
+  // Updates the rates for all ticks completed until the given time.
+  void Tick(const ClockDiff& now) {
+    const int64_t interval = TickInterval().Nanos();
+    const int64_t ticks = (now - last_tick_).Nanos() / interval;
+    if (ticks <= 0) {
+      return;
+    }
+    const int64_t count = Count();
+    const double per_tick = static_cast<double>(count - last_count_) / ticks;
+    const double rate = per_tick / TickInterval().Secs<double>();
+    static const double kWindowSecs[kNumAverages] = {60.0, 300.0, 900.0};
+    for (int m = 0; m < kNumAverages; ++m) {
+      // Closed form of ticks updates with constant rate.
+      const double decay = std::exp(-TickInterval().Secs<double>() * ticks /
+                                    kWindowSecs[m]);
+      averages_[m] = rate + (averages_[m] - rate) * decay;
+    }
+    for (int64_t t = 0; t < ticks && t < kWindowTicks; ++t) {
+      window_[window_pos_] = per_tick;
+      window_pos_ = (window_pos_ + 1) % kWindowTicks;
+    }
+    window_ticks_ = window_ticks_ + ticks < kWindowTicks ?
+        window_ticks_ + ticks : kWindowTicks;
+    instant_ = rate;
+    last_count_ = count;
+    last_tick_ += ClockDiff::FromNanos(ticks * interval);
+  }
+
+  std::unique_ptr<Shard[], ShardsDeleter> shards_;
+  const std::string unit_;
+  const ClockDiff start_;
+  // Rate state, guarded by the mutex.
+  std::mutex mutex_;
+  ClockDiff last_tick_;
+  int64_t last_count_;
+  double instant_;
+  double averages_[kNumAverages];
+  std::vector<double> window_;
+  int window_pos_;
+  int64_t window_ticks_;
+};
+
+}  // namespace time
+}  // namespace flow
+#endif  // SRC_TIME_METER_H_
@@ -0,0 +1,605 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_PROFILER_H_
+#define SRC_TIME_PROFILER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./clock.h"
+#include "./counters.h"
+#include "./macros.h"
+
+namespace flow {
+namespace time {
+
+// Clocks tracked by the profiler.
+enum ProfileClock {
+  kProfileWall = 0,
+  kProfileProcess = 1,
+  kProfileThread = 2,
+  kNumProfileClocks = 3,
+};
+
+// Merged statistics for a profiled section in the call tree.
+struct ProfileEntry {
+  ProfileEntry()
+      : count() {}
+
+  // Returns the string representation of the subtree rooted at this entry.
+  std::string Str(int depth = 0) const;
+
+  std::string name;
+  int64_t count;
+  ClockDiff total[kNumProfileClocks];
+  ClockDiff self[kNumProfileClocks];
+  ClockDiff min[kNumProfileClocks];
+  ClockDiff max[kNumProfileClocks];
+  // Hardware events counted in total, if enabled.
+  CounterDiff counters;
+  std::vector<ProfileEntry> children;
+};
+
+// Call-tree profile merged over all threads.
+struct ProfileReport {
+  // Returns the entry for the given path of section names or nullptr.
+  const ProfileEntry* Find(const std::vector<std::string>& path) const;
+
+  // Returns the string representation of the whole call tree.
+  std::string Str() const;
+
+  std::vector<ProfileEntry> roots;
+};
+
+// Stream output operator overload for ProfileReport.
+inline std::ostream& operator<<(std::ostream& stream,
+                                const ProfileReport& report) {
+  return stream << report.Str();
+}
+
+namespace internal {
+
+// Per-thread call-tree node. The node structure is written once before it is
+// published, the statistics are updated by the owning thread only. Relaxed
+// atomic loads and stores compile to plain moves and allow concurrent merges
+// without data races; merged snapshots may therefore be slightly skewed.
+struct ProfileNode {
+  typedef std::atomic<int64_t> Counter;
+
+  const char* name;
+  int parent;
+  int first_child;
+  int next_sibling;
+  Counter count;
+  Counter total[kNumProfileClocks];
+  Counter min[kNumProfileClocks];
+  Counter max[kNumProfileClocks];
+  Counter events[kNumCounterEvents];
+};
+
+// Single-writer update of the given counter.
+inline void Add(ProfileNode::Counter* counter, int64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+// Call-tree profile owned by a single thread. Resets are requested by
+// advancing the shared reset generation; the owning thread clears its own
+// statistics on its next Enter or Exit, so the counters have a single writer.
+class ThreadProfile {
+ public:
+  static const int kChunkSize = 256;
+  static const int kMaxChunks = 64;
+  static const int kRoot = 0;
+
+  explicit ThreadProfile(const std::atomic<uint64_t>* reset_generation)
+      : reset_generation_(reset_generation),
+        generation_(reset_generation->load(std::memory_order_acquire)),
+        size_(0),
+        current_(kRoot) {
+    for (int i = 0; i < kMaxChunks; ++i) {
+      chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+    NewNode("", -1);
+  }
+
+  ~ThreadProfile() {
+    for (int i = 0; i < kMaxChunks; ++i) {
+      delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  // Enters the child section of the current section with given name. Returns
+  // the index of the entered node or -1 if the node capacity is exhausted.
+  int Enter(const char* name) {
+    Sync();
+    ProfileNode& parent = Node(current_);
+    int child = parent.first_child;
+    while (child != -1 && Node(child).name != name) {
+      child = Node(child).next_sibling;
+    }
+    if (child == -1) {
+      child = NewNode(name, current_);
+      if (child == -1) {
+        return -1;
+      }
+      ProfileNode& node = Node(child);
+      node.next_sibling = parent.first_child;
+      parent.first_child = child;
+    }
+    current_ = child;
+    return child;
+  }
+
+  // Leaves the given node and adds the measured durations for the first
+  // num_clocks clocks and the counted events, if given.
+  void Exit(int index, const int64_t* durations, int num_clocks,
+            const int64_t* events) {
+    Sync();
+    ProfileNode& node = Node(index);
+    current_ = node.parent;
+    Add(&node.count, 1);
+    for (int c = 0; c < num_clocks; ++c) {
+      const int64_t d = durations[c];
+      Add(&node.total[c], d);
+      if (d < node.min[c].load(std::memory_order_relaxed)) {
+        node.min[c].store(d, std::memory_order_relaxed);
+      }
+      if (d > node.max[c].load(std::memory_order_relaxed)) {
+        node.max[c].store(d, std::memory_order_relaxed);
+      }
+    }
+    if (events != nullptr) {
+      for (int e = 0; e < kNumCounterEvents; ++e) {
+        Add(&node.events[e], events[e]);
+      }
+    }
+  }
+
+  // Returns the reset generation of the statistics.
+  uint64_t Generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  // Returns the number of published nodes.
+  int Size() const {
+    return size_.load(std::memory_order_acquire);
+  }
+
+  // Returns the node with given index.
+  ProfileNode& Node(int index) {
+    return chunks_[index / kChunkSize].load(std::memory_order_relaxed)
+        [index % kChunkSize];
+  }
+
+  // Returns the node with given index.
+  const ProfileNode& Node(int index) const {
+    return chunks_[index / kChunkSize].load(std::memory_order_acquire)
+        [index % kChunkSize];
+  }
+
+ private:
+  // Clears the statistics of all nodes if a reset was requested since the
+  // last call. The call tree is kept, since the thread may be inside its
+  // sections.
+  void Sync() {
+    const uint64_t generation =
+        reset_generation_->load(std::memory_order_acquire);
+    if (generation == generation_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    const int size = size_.load(std::memory_order_relaxed);
+    for (int i = 0; i < size; ++i) {
+      ResetNode(&Node(i));
+    }
+    generation_.store(generation, std::memory_order_release);
+  }
+
+  // Creates and publishes a new node. Returns its index or -1 if the node
+  // capacity is exhausted.
+  int NewNode(const char* name, int parent) {
+    const int index = size_.load(std::memory_order_relaxed);
+    if (index >= kChunkSize * kMaxChunks) {
+      return -1;
+    }
+    if (index % kChunkSize == 0) {
+      chunks_[index / kChunkSize].store(new ProfileNode[kChunkSize],
+                                        std::memory_order_release);
+    }
+    ProfileNode& node = Node(index);
+    node.name = name;
+    node.parent = parent;
+    node.first_child = -1;
+    node.next_sibling = -1;
+    ResetNode(&node);
+    size_.store(index + 1, std::memory_order_release);
+    return index;
+  }
+
+  // Clears the statistics of the given node.
+  static void ResetNode(ProfileNode* node) {
+    node->count.store(0, std::memory_order_relaxed);
+    for (int c = 0; c < kNumProfileClocks; ++c) {
+      node->total[c].store(0, std::memory_order_relaxed);
+      node->min[c].store(std::numeric_limits<int64_t>::max(),
+                         std::memory_order_relaxed);
+      node->max[c].store(0, std::memory_order_relaxed);
+    }
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      node->events[e].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  const std::atomic<uint64_t>* reset_generation_;
+  std::atomic<uint64_t> generation_;
+  std::atomic<ProfileNode*> chunks_[kMaxChunks];
+  std::atomic<int> size_;
+  int current_;
+};
+
+// Node of the merged call tree used while building reports.
+struct MergeNode {
+  std::string name;
+  std::map<std::string, int> children;
+  ProfileEntry entry;
+};
+
+// Merges the given thread profile into the merged call tree, which must contain
+// at least the root node. Sections are merged by name along their call path.
+inline void MergeThreadProfile(const ThreadProfile& profile,
+                               std::vector<MergeNode>* nodes) {
+  const int size = profile.Size();
+  // Maps the thread's node indices to merged node indices, parents always
+  // precede their children.
+  std::vector<int> merged(size, 0);
+  for (int i = ThreadProfile::kRoot + 1; i < size; ++i) {
+    const ProfileNode& node = profile.Node(i);
+    const int parent = merged[node.parent];
+    const std::string name = node.name;
+    auto it = (*nodes)[parent].children.find(name);
+    if (it == (*nodes)[parent].children.end()) {
+      it = (*nodes)[parent].children.insert(
+          std::make_pair(name, static_cast<int>(nodes->size()))).first;
+      nodes->push_back(MergeNode());
+      nodes->back().name = name;
+    }
+    merged[i] = it->second;
+    const int64_t count = node.count.load(std::memory_order_relaxed);
+    if (count == 0) {
+      continue;
+    }
+    ProfileEntry& entry = (*nodes)[merged[i]].entry;
+    const bool first = entry.count == 0;
+    entry.count += count;
+    for (int c = 0; c < kNumProfileClocks; ++c) {
+      const int64_t total = node.total[c].load(std::memory_order_relaxed);
+      int64_t min = node.min[c].load(std::memory_order_relaxed);
+      const int64_t max = node.max[c].load(std::memory_order_relaxed);
+      if (min > max) {
+        // Clock not measured.
+        min = 0;
+      }
+      entry.total[c] += ClockDiff::FromNanos(total);
+      if (first || ClockDiff::FromNanos(min) < entry.min[c]) {
+        entry.min[c] = ClockDiff::FromNanos(min);
+      }
+      if (first || ClockDiff::FromNanos(max) > entry.max[c]) {
+        entry.max[c] = ClockDiff::FromNanos(max);
+      }
+    }
+    int64_t events[kNumCounterEvents];
+    for (int e = 0; e < kNumCounterEvents; ++e) {
+      events[e] = node.events[e].load(std::memory_order_relaxed);
+    }
+    entry.counters += CounterDiff(ClockDiff(), events, events[kCycles] > 0);
+  }
+}
+
+// Registry of the profiles of running threads and the merged profiles of
+// exited threads, guarded by the mutex.
+struct ProfileRegistry {
+  ProfileRegistry()
+      : generation(0),
+        exited(1) {}
+
+  // Advanced by each reset, written under the mutex.
+  std::atomic<uint64_t> generation;
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadProfile> > profiles;
+  std::vector<MergeNode> exited;
+};
+
+inline ProfileRegistry& Registry() {
+  static ProfileRegistry registry;
+  return registry;
+}
+
+// Creates and registers the calling thread's profile.
+inline ThreadProfile* RegisterThreadProfile() {
+  ProfileRegistry& registry = Registry();
+  std::shared_ptr<ThreadProfile> profile(
+      new ThreadProfile(&registry.generation));
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.profiles.push_back(profile);
+  return profile.get();
+}
+
+// Merges the given profile of an exiting thread into the registry's exited
+// profiles, unless it predates the last reset, and unregisters it.
+inline void RetireThreadProfile(ThreadProfile* profile) {
+  ProfileRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  if (profile->Generation() ==
+      registry.generation.load(std::memory_order_relaxed)) {
+    MergeThreadProfile(*profile, &registry.exited);
+  }
+  for (auto it = registry.profiles.begin(); it != registry.profiles.end();
+       ++it) {
+    if (it->get() == profile) {
+      registry.profiles.erase(it);
+      break;
+    }
+  }
+}
+
+// Owns the calling thread's profile and retires it when the thread exits.
+struct LocalProfile {
+  LocalProfile()
+      : profile(nullptr) {}
+
+  ~LocalProfile() {
+    if (profile != nullptr) {
+      RetireThreadProfile(profile);
+    }
+  }
+
+  ThreadProfile* profile;
+};
+
+// Returns the calling thread's profile.
+inline ThreadProfile* LocalThreadProfile() {
+  static thread_local LocalProfile local;
+  if (local.profile == nullptr) {
+    local.profile = RegisterThreadProfile();
+  }
+  return local.profile;
+}
+
+// Whether scopes additionally measure process and thread CPU-time.
+inline std::atomic<bool>& CpuClocksEnabled() {
+  static std::atomic<bool> enabled(false);
+  return enabled;
+}
+
+// Whether scopes additionally count hardware events.
+inline std::atomic<bool>& CountersEnabled() {
+  static std::atomic<bool> enabled(false);
+  return enabled;
+}
+
+}  // namespace internal
+
+// Hierarchical profiler collecting the sections measured by ProfileScope.
+class Profiler {
+ public:
+  // Enables or disables process and thread CPU-time measurement. The CPU
+  // clocks require system calls and add several hundred nanoseconds per scope,
+  // the wall-clock is always measured.
+  static void EnableCpuClocks(bool enable) {
+    internal::CpuClocksEnabled().store(enable, std::memory_order_relaxed);
+  }
+
+  // Returns whether CPU-time measurement is enabled.
+  static bool CpuClocksEnabled() {
+    return internal::CpuClocksEnabled().load(std::memory_order_relaxed);
+  }
+
+  // Enables or disables hardware event counting via CounterClock. Reading the
+  // counters requires system calls and adds about a microsecond per scope.
+  // Sections are measured by wall-clock only if the counters are unavailable.
+  static void EnableCounters(bool enable) {
+    internal::CountersEnabled().store(enable, std::memory_order_relaxed);
+  }
+
+  // Returns whether hardware event counting is enabled.
+  static bool CountersEnabled() {
+    return internal::CountersEnabled().load(std::memory_order_relaxed);
+  }
+
+  // Merges the profiles of all threads into a report. Sections are merged by
+  // name along their call path.
+  static ProfileReport Report();
+
+  // Clears the measurements of all threads. Each running thread clears its own
+  // measurements on its next section entry or exit, sections running
+  // concurrently may be partially counted afterwards.
+  static void Reset();
+};
+
+// Scoped timer, measures its lifetime as a section of the calling thread's
+// call-tree profile. The name must outlive the program (e.g. string literal),
+// sections are identified by the name's address within a thread.
+class ProfileScope {
+ public:
+  explicit ProfileScope(const char* name)
+      : profile_(internal::LocalThreadProfile()),
+        index_(profile_->Enter(name)),
+        num_clocks_(Profiler::CpuClocksEnabled() ? kNumProfileClocks : 1),
+        counters_(Profiler::CountersEnabled() &&
+                  CounterGroup::Local().Available()) {
+    if (counters_) {
+      CounterGroup::Local().Read(begin_events_);
+    }
+    if (num_clocks_ > 1) {
+      begin_[kProfileProcess] = ProcessClock::Now().Nanos();
+      begin_[kProfileThread] = ThreadClock::Now().Nanos();
+    }
+    begin_[kProfileWall] = Clock::Now().Nanos();
+  }
+
+  ~ProfileScope() {
+    int64_t durations[kNumProfileClocks];
+    durations[kProfileWall] = Clock::Now().Nanos() - begin_[kProfileWall];
+    if (num_clocks_ > 1) {
+      durations[kProfileThread] = ThreadClock::Now().Nanos() -
+                                  begin_[kProfileThread];
+      durations[kProfileProcess] = ProcessClock::Now().Nanos() -
+                                   begin_[kProfileProcess];
+    }
+    int64_t events[kNumCounterEvents];
+    if (counters_) {
+      CounterGroup::Local().Read(events);
+      for (int e = 0; e < kNumCounterEvents; ++e) {
+        events[e] -= begin_events_[e];
+      }
+    }
+    if (index_ != -1) {
+      profile_->Exit(index_, durations, num_clocks_,
+                     counters_ ? events : nullptr);
+    }
+  }
+
+ private:
+  ProfileScope(const ProfileScope&);
+  ProfileScope& operator=(const ProfileScope&);
+
+  internal::ThreadProfile* profile_;
+  const int index_;
+  const int num_clocks_;
+  const bool counters_;
+  int64_t begin_[kNumProfileClocks];
+  int64_t begin_events_[kNumCounterEvents];
+};
+
+// Profiles the remainder of the enclosing scope as section with given name.
+#define FLOW_PROFILE_SCOPE(name) \
+  ::flow::time::ProfileScope FLOW_CONCAT(flow_profile_scope_, \
+                                                 __LINE__)(name)
+
+// Profiles the remainder of the enclosing function.
+#define FLOW_PROFILE_FUNCTION() FLOW_PROFILE_SCOPE(__func__)
+
+namespace internal {
+
+// Converts the merged node with given index recursively into an entry and
+// computes the self times. Subtrees without measurements (e.g. after a reset)
+// are omitted.
+inline ProfileEntry ToEntry(std::vector<MergeNode>* nodes, int index) {
+  MergeNode& node = (*nodes)[index];
+  ProfileEntry entry = node.entry;
+  entry.name = node.name;
+  for (int c = 0; c < kNumProfileClocks; ++c) {
+    entry.self[c] = entry.total[c];
+  }
+  for (const auto& child: node.children) {
+    ProfileEntry child_entry = ToEntry(nodes, child.second);
+    if (child_entry.count == 0 && child_entry.children.empty()) {
+      continue;
+    }
+    for (int c = 0; c < kNumProfileClocks; ++c) {
+      entry.self[c] -= child_entry.total[c];
+    }
+    entry.children.push_back(std::move(child_entry));
+  }
+  for (int c = 0; c < kNumProfileClocks; ++c) {
+    // Guards against skew of concurrently updated snapshots.
+    if (entry.self[c] < ClockDiff()) {
+      entry.self[c] = ClockDiff();
+    }
+  }
+  return entry;
+}
+
+}  // namespace internal
+
+inline ProfileReport Profiler::Report() {
+  std::vector<std::shared_ptr<internal::ThreadProfile> > profiles;
+  std::vector<internal::MergeNode> nodes;
+  uint64_t generation = 0;
+  {
+    internal::ProfileRegistry& registry = internal::Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    profiles = registry.profiles;
+    nodes = registry.exited;
+    generation = registry.generation.load(std::memory_order_relaxed);
+  }
+  for (const auto& profile: profiles) {
+    // Profiles not cleared by their thread since the last reset are empty.
+    if (profile->Generation() == generation) {
+      internal::MergeThreadProfile(*profile, &nodes);
+    }
+  }
+  ProfileReport report;
+  report.roots = internal::ToEntry(&nodes, 0).children;
+  return report;
+}
+
+inline void Profiler::Reset() {
+  internal::ProfileRegistry& registry = internal::Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.exited.assign(1, internal::MergeNode());
+  registry.generation.fetch_add(1, std::memory_order_release);
+}
+
+inline const ProfileEntry* ProfileReport::Find(
+    const std::vector<std::string>& path) const {
+  const std::vector<ProfileEntry>* entries = &roots;
+  const ProfileEntry* found = nullptr;
+  for (const auto& name: path) {
+    found = nullptr;
+    for (const auto& entry: *entries) {
+      if (entry.name == name) {
+        found = &entry;
+        break;
+      }
+    }
+    if (found == nullptr) {
+      return nullptr;
+    }
+    entries = &found->children;
+  }
+  return found;
+}
+
+inline std::string ProfileEntry::Str(int depth) const {
+  static const char* kClockNames[kNumProfileClocks] = {"wall", "proc", "thrd"};
+  std::stringstream ss;
+  ss << std::string(2 * depth, ' ') << name << ": " << count << "x";
+  for (int c = 0; c < kNumProfileClocks; ++c) {
+    if (c != kProfileWall && max[c] == ClockDiff()) {
+      continue;
+    }
+    ss << " | " << kClockNames[c]
+       << " total " << total[c].Str()
+       << " self " << self[c].Str()
+       << " min " << min[c].Str()
+       << " max " << max[c].Str();
+  }
+  if (counters.HasCounters()) {
+    ss << " | " << counters.EventsStr(count);
+  }
+  ss << "\n";
+  for (const auto& child: children) {
+    ss << child.Str(depth + 1);
+  }
+  return ss.str();
+}
+
+inline std::string ProfileReport::Str() const {
+  std::string str;
+  for (const auto& root: roots) {
+    str += root.Str();
+  }
+  return str;
+}
+
+}  // namespace time
+}  // namespace flow
+#endif  // SRC_TIME_PROFILER_H_
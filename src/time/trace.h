@@ -0,0 +1,355 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TIME_TRACE_H_
+#define SRC_TIME_TRACE_H_
+
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "./clock.h"
+#include "./macros.h"
+
+namespace flow {
+namespace time {
+
+namespace internal {
+
+// Ring buffer slot for a complete span. The sequence number is odd while the
+// slot is written and even once the span at its position is complete, readers
+// use it to detect torn reads of overwritten slots. All fields are accessed by
+// relaxed atomics which compile to plain moves.
+struct TraceSlot {
+  std::atomic<uint64_t> seq;
+  std::atomic<const char*> name;
+  std::atomic<int64_t> begin;
+  std::atomic<int64_t> duration;
+};
+
+// Span recorded in the trace.
+struct TraceEvent {
+  const char* name;
+  int64_t begin;
+  int64_t duration;
+};
+
+// Preallocated per-thread ring buffer of spans. The owning thread is the only
+// writer, the oldest spans are overwritten when the buffer is full.
+class TraceBuffer {
+ public:
+  TraceBuffer(int tid, size_t capacity)
+      : exited(false),
+        tid_(tid),
+        capacity_(capacity > 0 ? capacity : 1),
+        slots_(new TraceSlot[capacity_]),
+        written_(0),
+        read_(0) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      slots_[i].seq.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Records the span with given name, begin time and duration in nanoseconds.
+  void Record(const char* name, int64_t begin, int64_t duration) {
+    const uint64_t pos = written_.load(std::memory_order_relaxed);
+    TraceSlot& slot = slots_[pos % capacity_];
+    slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.duration.store(duration, std::memory_order_relaxed);
+    slot.seq.store(2 * pos + 2, std::memory_order_release);
+    written_.store(pos + 1, std::memory_order_release);
+  }
+
+  // Appends the spans recorded since the last call to the given vector and
+  // returns the number of spans lost due to overwrites. Not thread-safe with
+  // respect to other readers.
+  uint64_t Consume(std::vector<TraceEvent>* events) {
+    const uint64_t written = written_.load(std::memory_order_acquire);
+    uint64_t lost = 0;
+    uint64_t pos = read_;
+    if (written - pos > capacity_) {
+      lost = written - capacity_ - pos;
+      pos = written - capacity_;
+    }
+    for (; pos < written; ++pos) {
+      const TraceSlot& slot = slots_[pos % capacity_];
+      const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      TraceEvent event;
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.begin = slot.begin.load(std::memory_order_relaxed);
+      event.duration = slot.duration.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq != 2 * pos + 2 ||
+          slot.seq.load(std::memory_order_relaxed) != seq) {
+        // Overwritten while reading.
+        ++lost;
+        continue;
+      }
+      events->push_back(event);
+    }
+    read_ = written;
+    return lost;
+  }
+
+  int Tid() const {
+    return tid_;
+  }
+
+  // Returns whether all recorded spans have been consumed. Not thread-safe
+  // with respect to Consume.
+  bool Drained() const {
+    return read_ == written_.load(std::memory_order_acquire);
+  }
+
+  // Thread name and whether the owning thread has exited, guarded by the
+  // tracer registry mutex.
+  std::string name;
+  bool exited;
+
+ private:
+  TraceBuffer(const TraceBuffer&);
+  TraceBuffer& operator=(const TraceBuffer&);
+
+  const int tid_;
+  const size_t capacity_;
+  std::unique_ptr<TraceSlot[]> slots_;
+  std::atomic<uint64_t> written_;
+  uint64_t read_;
+};
+
+// Registry of the trace buffers, guarded by the mutex. Buffers outlive their
+// threads until their spans have been flushed.
+struct TraceRegistry {
+  TraceRegistry()
+      : enabled(false),
+        capacity(1 << 16),
+        next_tid(1) {}
+
+  std::atomic<bool> enabled;
+  std::mutex mutex;
+  size_t capacity;
+  int next_tid;
+  std::vector<std::shared_ptr<TraceBuffer> > buffers;
+};
+
+inline TraceRegistry& Tracing() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+// Creates and registers the calling thread's trace buffer.
+inline TraceBuffer* RegisterTraceBuffer() {
+  TraceRegistry& registry = Tracing();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::shared_ptr<TraceBuffer> buffer(new TraceBuffer(registry.next_tid++,
+                                                     registry.capacity));
+  registry.buffers.push_back(buffer);
+  return buffer.get();
+}
+
+// Unregisters the given buffer of an exiting thread if it is drained,
+// otherwise it is unregistered by the next flush.
+inline void RetireTraceBuffer(TraceBuffer* buffer) {
+  TraceRegistry& registry = Tracing();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  buffer->exited = true;
+  if (!buffer->Drained()) {
+    return;
+  }
+  for (auto it = registry.buffers.begin(); it != registry.buffers.end(); ++it) {
+    if (it->get() == buffer) {
+      registry.buffers.erase(it);
+      break;
+    }
+  }
+}
+
+// Owns the calling thread's trace buffer registration and retires it when the
+// thread exits.
+struct LocalTrace {
+  LocalTrace()
+      : buffer(nullptr) {}
+
+  ~LocalTrace() {
+    if (buffer != nullptr) {
+      RetireTraceBuffer(buffer);
+    }
+  }
+
+  TraceBuffer* buffer;
+};
+
+// Returns the calling thread's trace buffer.
+inline TraceBuffer* LocalTraceBuffer() {
+  static thread_local LocalTrace local;
+  if (local.buffer == nullptr) {
+    local.buffer = RegisterTraceBuffer();
+  }
+  return local.buffer;
+}
+
+// Writes the given string JSON-escaped to the stream.
+inline void WriteJsonString(const std::string& str, std::ostream& stream) {
+  stream << '"';
+  for (const char c: str) {
+    if (c == '"' || c == '\\') {
+      stream << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      stream << escaped;
+    } else {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+
+// Writes the given nanoseconds as microseconds to the stream.
+inline void WriteMicros(int64_t nanos, std::ostream& stream) {
+  char micros[32];
+  snprintf(micros, sizeof(micros), "%lld.%03lld",
+           static_cast<long long>(nanos / ClockDiff::kNanoInMicro),  // NOLINT
+           static_cast<long long>(nanos % ClockDiff::kNanoInMicro));  // NOLINT
+  stream << micros;
+}
+
+}  // namespace internal
+
+// Timeline tracer recording spans into preallocated per-thread ring buffers.
+// Recording takes no locks and does not allocate, except for the first span
+// of each thread which allocates its buffer. The recorded spans are flushed as
+// Chrome trace-event JSON, to be opened in about:tracing or Perfetto.
+class Tracer {
+ public:
+  // Enables or disables span recording. Disabled scopes cost one relaxed load.
+  static void Enable(bool enable) {
+    internal::Tracing().enabled.store(enable, std::memory_order_relaxed);
+  }
+
+  // Returns whether span recording is enabled.
+  static bool Enabled() {
+    return internal::Tracing().enabled.load(std::memory_order_relaxed);
+  }
+
+  // Sets the number of spans per thread buffer, applies to buffers created
+  // afterwards.
+  static void SetBufferSize(size_t num_spans) {
+    internal::TraceRegistry& registry = internal::Tracing();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.capacity = num_spans;
+  }
+
+  // Sets the name of the calling thread shown in the timeline.
+  static void SetThreadName(const std::string& name) {
+    internal::TraceBuffer* buffer = internal::LocalTraceBuffer();
+    internal::TraceRegistry& registry = internal::Tracing();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffer->name = name;
+  }
+
+  // Records a span with given name, begin time and duration (as returned by
+  // Clock::Now), regardless whether recording is enabled.
+  static void Record(const char* name, const ClockDiff& begin,
+                     const ClockDiff& duration) {
+    internal::LocalTraceBuffer()->Record(name, begin.Nanos(),
+                                         duration.Nanos());
+  }
+
+  // Writes the spans recorded since the last flush as Chrome trace JSON to the
+  // stream. Returns the number of spans lost due to ring buffer overwrites.
+  // The buffers of exited threads are released once flushed.
+  static uint64_t Flush(std::ostream& stream) {
+    internal::TraceRegistry& registry = internal::Tracing();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const int pid = getpid();
+    uint64_t lost = 0;
+    bool first = true;
+    stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    std::vector<internal::TraceEvent> events;
+    for (const auto& buffer: registry.buffers) {
+      if (!buffer->name.empty()) {
+        stream << (first ? "\n" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+               << ",\"tid\":" << buffer->Tid() << ",\"args\":{\"name\":";
+        internal::WriteJsonString(buffer->name, stream);
+        stream << "}}";
+        first = false;
+      }
+      events.clear();
+      lost += buffer->Consume(&events);
+      for (const auto& event: events) {
+        stream << (first ? "\n" : ",\n") << "{\"name\":";
+        internal::WriteJsonString(event.name, stream);
+        stream << ",\"ph\":\"X\",\"ts\":";
+        internal::WriteMicros(event.begin, stream);
+        stream << ",\"dur\":";
+        internal::WriteMicros(event.duration, stream);
+        stream << ",\"pid\":" << pid << ",\"tid\":" << buffer->Tid() << "}";
+        first = false;
+      }
+    }
+    std::vector<std::shared_ptr<internal::TraceBuffer> > live;
+    for (const auto& buffer: registry.buffers) {
+      if (!buffer->exited) {
+        live.push_back(buffer);
+      }
+    }
+    registry.buffers.swap(live);
+    stream << "\n]}\n";
+    return lost;
+  }
+
+  // Flushes the recorded spans to the file at given path. Returns false if the
+  // file could not be written.
+  static bool Flush(const std::string& path) {
+    std::ofstream file(path.c_str());
+    if (!file) {
+      return false;
+    }
+    Flush(file);
+    return static_cast<bool>(file);
+  }
+};
+
+// Scoped span, records its lifetime in the calling thread's trace buffer if
+// recording is enabled at construction. The name must outlive the tracer
+// (e.g. string literal).
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name)
+      : name_(name),
+        begin_(Tracer::Enabled() ? Clock::Now().Nanos() : -1) {}
+
+  ~TraceScope() {
+    if (begin_ >= 0) {
+      const int64_t end = Clock::Now().Nanos();
+      internal::LocalTraceBuffer()->Record(name_, begin_, end - begin_);
+    }
+  }
+
+ private:
+  TraceScope(const TraceScope&);
+  TraceScope& operator=(const TraceScope&);
+
+  const char* name_;
+  const int64_t begin_;
+};
+
+// Traces the remainder of the enclosing scope as span with given name.
+#define FLOW_TRACE_SCOPE(name) \
+  ::flow::time::TraceScope FLOW_CONCAT(flow_trace_scope_, __LINE__)(name)
+
+// Traces the remainder of the enclosing function.
+#define FLOW_TRACE_FUNCTION() FLOW_TRACE_SCOPE(__func__)
+
+}  // namespace time
+}  // namespace flow
+#endif  // SRC_TIME_TRACE_H_
@@ -0,0 +1,7 @@
+// Copyright 2013 Eugen Sawin <esawin@me73.com>
+#ifndef SRC_TRACE_H_
+#define SRC_TRACE_H_
+
+#include "./time/trace.h"
+
+#endif  // SRC_TRACE_H_